@@ -72,6 +72,7 @@ def CreateParamDict(params):
     param_dict = dict()
     param_dict['output_dir'] = params.output
     param_dict['graph_filename'] = params.graph
+    param_dict['graph_format'] = params.graph_format
     param_dict['threads_count'] = params.num_threads
     param_dict['min_fillin_threshold'] = params.min_fillin
     param_dict['min_graph_size'] = params.min_graph_size
@@ -118,7 +119,7 @@ def main(argv, external_logger = ""):
                             type=str,
                             default="",
                             dest="graph",
-                            help="Input graph in GRAPH format")
+                            help="Input graph in GRAPH format or in binary format of ig_swgraph_construct")
     input_args.add_argument("--test",
                             action="store_const",
                             const=os.path.join(home_directory, "test_dataset/dsf/test.graph"),
@@ -154,6 +155,13 @@ def main(argv, external_logger = ""):
                                dest="min_graph_size",
                                help="Minimum size of graph where dense subgraphs will be computed "
                                     "[default: %(default)d]")
+    optional_args.add_argument("--graph-format",
+                               type=str,
+                               default="auto",
+                               choices=["auto", "metis", "binary"],
+                               dest="graph_format",
+                               help="Format of input graph: GRAPH (METIS), binary or auto detection "
+                                    "[default: %(default)s]")
     optional_args.add_argument("--create-triv-dec",
                                action="store_const",
                                const=True,
@@ -459,7 +459,8 @@ class GraphConstructionPhase(Phase):
         self.__CheckInputExistance()
         command_line = IgRepConConfig().run_graph_constructor + " -i " + self.__params.io.compressed_reads + \
                        " -o " + self.__params.io.sw_graph + " -t " + str(self.__params.num_threads) + \
-                       " --tau=" + str(self.__params.max_mismatches) + " -A" + " -Toff"
+                       " --tau=" + str(self.__params.max_mismatches) + " -A" + " -Toff" + \
+                       " --graph-format=" + self.__params.graph_format
         support.sys_call(command_line, self._log)
 
     def PrintOutputFiles(self):
@@ -826,6 +827,14 @@ def ParseCommandLineParams(log):
                           dest="save_aux_files",
                           help="Saving auxiliary files: subgraphs in GRAPH format and their decompositions "
                           "[default: False]")
+    dev_args.add_argument("--graph-format",
+                          type=str,
+                          default="metis",
+                          choices=["metis", "binary"],
+                          dest="graph_format",
+                          help="Format of Smith-Waterman graph: GRAPH (METIS) or binary, which is loaded by "
+                          "Dense Subgraph Finder without parsing, but is not readable by GRAPH consumers "
+                          "[default: %(default)s]")
     dev_args.add_argument("--debug",
                           action="store_const",
                           const=True,
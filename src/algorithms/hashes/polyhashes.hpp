@@ -1,35 +1,159 @@
 #pragma once
 
-#include <vector>
+#include <cstdint>
 #include <seqan/sequence.h>
 
 namespace algorithms {
-    // TODO Reimplement it as "generator" with O(1) memory consumption
-    // WARNING: require seqan::length() for string s
-    // Make sure that function seqan::string(T s) is defined
+    // Treatment of k-mers that contain N
+    enum class NPolicy {
+        // N is hashed as A. Every window gets a hash, so k-mer positions stay dense, and equal windows
+        // always get equal hashes. A window with N also collides with the same window carrying A,
+        // i.e., candidate sets based on such hashes can only grow
+        AsA,
+        // Windows that contain N are not reported
+        Skip
+    };
+
+    struct KmerHash {
+        size_t position;
+        size_t hash;
+    };
+
+    // Allocation-free rolling hash over 2-bit encoded k-mers of sequence s.
+    // For K <= 32 hash is the exact 2-bit packing of the k-mer (no collisions),
+    // for longer k-mers it is a polynomial hash modulo 2^64.
+    // WARNING: require length() (seqan or found by ADL) and operator[] convertible to seqan::Dna5 for sequence type T
     template<typename T>
-    std::vector<size_t> polyhashes(const T &s, size_t K) {
-        if (seqan::length(s) < K) {
-            return {  };
+    class KmerHashes {
+    public:
+        class Iterator {
+        public:
+            Iterator(const KmerHashes &owner, size_t next) : owner_(&owner), next_(next) {
+                if (next_ == 0) {
+                    Init();
+                }
+            }
+
+            KmerHash operator*() const {
+                return { next_ - owner_->k_, hash_ };
+            }
+
+            Iterator& operator++() {
+                Advance();
+                SkipInvalid();
+                return *this;
+            }
+
+            bool operator==(const Iterator &other) const { return next_ == other.next_; }
+
+            bool operator!=(const Iterator &other) const { return next_ != other.next_; }
+
+            static constexpr size_t kMultiplier = 0x9E3779B97F4A7C15ull;
+
+        private:
+            const KmerHashes *owner_;
+            size_t next_;
+            size_t hash_ = 0;
+            size_t n_count_ = 0;
+
+            unsigned Code(size_t i) const {
+                return seqan::ordValue(seqan::Dna5(owner_->s_[i]));
+            }
+
+            void Push(size_t i) {
+                unsigned c = Code(i);
+                n_count_ += (c > 3);
+                if (owner_->k_ <= 32) {
+                    hash_ = ((hash_ << 2) | (c & 3)) & owner_->mask_;
+                } else {
+                    hash_ = hash_ * kMultiplier + (c & 3);
+                }
+            }
+
+            void Pop(size_t i) {
+                unsigned c = Code(i);
+                n_count_ -= (c > 3);
+                if (owner_->k_ > 32) {
+                    hash_ -= (c & 3) * owner_->pow_k_;
+                }
+            }
+
+            void Advance() {
+                if (next_ >= owner_->length_) {
+                    next_ = owner_->length_ + 1;
+                    return;
+                }
+                Pop(next_ - owner_->k_);
+                Push(next_);
+                ++next_;
+            }
+
+            void SkipInvalid() {
+                if (owner_->policy_ == NPolicy::Skip) {
+                    while (n_count_ && next_ <= owner_->length_) {
+                        Advance();
+                    }
+                }
+            }
+
+            void Init() {
+                if (owner_->k_ == 0 || owner_->length_ < owner_->k_) {
+                    next_ = owner_->length_ + 1;
+                    return;
+                }
+                for (; next_ < owner_->k_; ++next_) {
+                    Push(next_);
+                }
+                SkipInvalid();
+            }
+        };
+
+        KmerHashes(const T &s, size_t k, NPolicy policy = NPolicy::AsA) :
+                s_(s),
+                k_(k),
+                length_(Length(s)),
+                policy_(policy) {
+            mask_ = (k_ >= 32) ? ~size_t(0) : ((size_t(1) << (2 * k_)) - 1);
+            pow_k_ = 1;
+            for (size_t i = 1; i < k_; ++i) {
+                pow_k_ *= Iterator::kMultiplier;
+            }
         }
-        const size_t p = 7;
-        std::vector<size_t> result(seqan::length(s) - K + 1);
-
-        size_t first = 0;
-        size_t p_pow_K = 1;
-        for (size_t i = 0; i < K; ++i) {
-            first *= p;
-            first += unsigned(s[i]);
-            p_pow_K *= p;
+
+        Iterator begin() const { return Iterator(*this, 0); }
+
+        Iterator end() const { return Iterator(*this, length_ + 1); }
+
+        // The number of windows, including ones that are skipped due to N
+        size_t NumWindows() const { return (length_ >= k_) ? length_ - k_ + 1 : 0; }
+
+    private:
+        static size_t Length(const T &s) {
+            using seqan::length;
+            return length(s);
         }
 
-        result[0] = first;
-        for (size_t i = 1; i < result.size(); ++i) {
-            first *= p;
-            first += unsigned(s[K + i - 1]); //size_t(s[K + i - 1]);
-            first -= unsigned(s[i - 1]) * p_pow_K; //size_t(s[i - 1]) * p_pow_K;
-            result[i] = first;
+        const T &s_;
+        size_t k_;
+        size_t length_;
+        NPolicy policy_;
+        size_t mask_;
+        size_t pow_k_; // weight of the oldest base in the window for k > 32
+    };
+
+    template<typename T>
+    KmerHashes<T> kmer_hashes(const T &s, size_t k, NPolicy policy = NPolicy::AsA) {
+        return KmerHashes<T>(s, k, policy);
+    }
+
+    // Hash of the single k-mer starting at position pos, consistent with KmerHashes (NPolicy::AsA)
+    template<typename T>
+    size_t kmer_hash(const T &s, size_t pos, size_t k) {
+        size_t hash = 0;
+        for (size_t i = pos; i < pos + k; ++i) {
+            size_t c = seqan::ordValue(seqan::Dna5(s[i])) & 3;
+            hash = (k <= 32) ? ((hash << 2) | c) : (hash * KmerHashes<T>::Iterator::kMultiplier + c);
         }
-        return result;
+        return hash;
     }
-}
\ No newline at end of file
+}
@@ -28,17 +28,12 @@ namespace algorithms {
         // inner structure
         std::unordered_map<size_t, std::vector<SubjectPosition>> kmer_query_pos_map_;
 
-        void UpdateMap(const std::vector<size_t>& str_hashes, size_t str_length, size_t str_index) {
-            for (size_t start = 0; start + k_ <= str_length; ++start) {
-                kmer_query_pos_map_[str_hashes[start]].push_back({str_index, start});
-            }
-        }
-
         void Initialize() {
             for (size_t j = 0; j < kmer_index_helper_.GetDbSize(); ++j) {
                 auto s = kmer_index_helper_.GetDbRecordByIndex(j);
-                auto hashes = polyhashes(s, k_);
-                UpdateMap(hashes, kmer_index_helper_.GetStringLength(s), j);
+                for (const auto &kmer : kmer_hashes(s, k_, NPolicy::Skip)) {
+                    kmer_query_pos_map_[kmer.hash].push_back({j, kmer.position});
+                }
             }
         }
 
@@ -69,20 +64,13 @@ namespace algorithms {
 
         SubjectKmerMatches GetSubjectKmerMatchesForQuery(const StringType &query_str) const {
             SubjectKmerMatches subj_kmer_matches(NumSubjects());
-            auto query_hashes = polyhashes(query_str, k());
-            size_t start = 0;
-            size_t finish = kmer_index_helper_.GetStringLength(query_str);
-            for(size_t j = start; j < finish - k() + 1; ++j) {
-                auto kmer = query_hashes[j];
-                if(!SubjectsContainKmer(kmer))
+            for (const auto &kmer : kmer_hashes(query_str, k(), NPolicy::Skip)) {
+                auto it = kmer_query_pos_map_.find(kmer.hash);
+                if (it == kmer_query_pos_map_.end())
                     continue;
-                auto subj_pos = GetSubjectPositions(kmer);
-                //for (const auto &p : subj_it.second) {
-                for(auto it = subj_pos.begin(); it != subj_pos.end(); it++) {
-                    size_t kmer_pos_in_query = j;
-                    size_t kmer_pos_in_subject = it->position; // p.position;
-                    subj_kmer_matches.Update(it->subject_index, {static_cast<int>(kmer_pos_in_subject),
-                                                             static_cast<int>(kmer_pos_in_query)});
+                for (const auto &p : it->second) {
+                    subj_kmer_matches.Update(p.subject_index, {static_cast<int>(p.position),
+                                                               static_cast<int>(kmer.position)});
                 }
             }
             return subj_kmer_matches;
@@ -22,6 +22,7 @@ void updateMetisIO(dsf_config::io_params &io, dsf_config::metis_io_params &metis
 void load(dsf_config::io_params::input_params &input_params, boost::property_tree::ptree const &pt, bool) {
     using config_common::load;
     load(input_params.graph_filename, pt, "graph_filename");
+    load(input_params.graph_format, pt, "graph_format", false);
 }
 
 void load(dsf_config::io_params::output_params &output_base, boost::property_tree::ptree const &pt, bool) {
@@ -9,6 +9,7 @@ struct dsf_config {
     struct io_params {
         struct input_params {
             std::string 	graph_filename;
+            std::string     graph_format = "auto";
         };
 
         struct output_params {
@@ -153,7 +153,7 @@ namespace {
 
 int dense_subgraph_finder::DenseSubgraphFinder::Run() {
     INFO("==== Dense subgraph finder starts");
-    GraphReader graph_reader(io_.input.graph_filename);
+    GraphReader graph_reader(io_.input.graph_filename, GraphFormatFromString(io_.input.graph_format));
     SparseGraphPtr graph_ptr = graph_reader.CreateGraph();
     if (!graph_ptr) {
         INFO("Dense subgraph finder was unable to extract graph from " << io_.input.graph_filename);
@@ -9,6 +9,8 @@
 #include <cassert>
 #include <vector>
 #include <algorithm>
+#include <cstddef>
+#include <limits>
 
 
 template<typename Ts1, typename Ts2, typename Tf>
@@ -81,4 +83,206 @@ int half_sw_banded(const Ts1 &s1, const Ts2 &s2,
     return max(-INF, base[max_indels]); // Score is always finite due to possibility to align using mismatches
 }
 
+
+// The number of equal characters of s1 and s2 starting from positions p1 and p2 respectively, at most max_len.
+// Requires p1 + max_len <= |s1|, p2 + max_len <= |s2|. Packed reads provide a word-parallel overload
+template<typename Ts1, typename Ts2>
+size_t common_prefix_length(const Ts1 &s1, size_t p1,
+                            const Ts2 &s2, size_t p2,
+                            size_t max_len) {
+    size_t res = 0;
+    while (res < max_len && s1[p1 + res] == s2[p2 + res]) {
+        ++res;
+    }
+    return res;
+}
+
+
+// Bounded banded half edit distance, i.e. -half_sw_banded(s1, s2, 0, -1, -1, lizard_tail, max_indels)
+// with tail_cost(l) = -lizard_tail(l), which must be non-negative.
+// Uses diagonal transition (Landau-Vishkin) instead of DP: for every error count e and every diagonal of the band
+// the furthest cell reachable with e errors is stored and then slid along the run of matches, so the work is
+// O(limit * band) plus match extension, which compares whole words for packed reads. No heap allocations for
+// bands up to 64 diagonals.
+// Returns the distance if it does not exceed limit and limit + 1 otherwise
+template<typename Ts1, typename Ts2, typename Tf>
+size_t half_edit_dist_banded(const Ts1 &s1, const Ts2 &s2,
+                             const Tf &tail_cost,
+                             size_t max_indels,
+                             size_t limit) {
+    using std::min;
+    using std::max;
+    using seqan::length;
+
+    const ptrdiff_t len1 = static_cast<ptrdiff_t>(length(s1));
+    const ptrdiff_t len2 = static_cast<ptrdiff_t>(length(s2));
+
+    // Reaching diagonal d = i2 - i1 requires |d| indels, so diagonals beyond limit are useless
+    const ptrdiff_t band = static_cast<ptrdiff_t>(min(max_indels, limit));
+    const ptrdiff_t dmin = -min(band, len1);
+    const ptrdiff_t dmax = min(band, len2);
+    const size_t num_diagonals = static_cast<size_t>(dmax - dmin + 1);
+
+    const size_t kStackDiagonals = 64;
+    ptrdiff_t stack_buffer[2 * kStackDiagonals];
+    std::vector<ptrdiff_t> heap_buffer;
+    ptrdiff_t *cur = stack_buffer;
+    if (num_diagonals > kStackDiagonals) {
+        heap_buffer.resize(2 * num_diagonals);
+        cur = heap_buffer.data();
+    }
+    ptrdiff_t *prev = cur + num_diagonals;
+
+    const ptrdiff_t NONE = -1;
+
+    // Row i1 of the terminal cell of diagonal d, i.e., the first cell where one of the strings is exhausted
+    auto end = [len1, len2](ptrdiff_t d) -> ptrdiff_t { return min(len1, len2 - d); };
+
+    // Alignment stops at terminal cells, so a reached terminal cell is left through its predecessor
+    // on the diagonal, which is reachable as well (costs are non-decreasing along diagonals)
+    auto source = [&end, NONE](ptrdiff_t i1, ptrdiff_t d) -> ptrdiff_t {
+        if (i1 == NONE) {
+            return NONE;
+        }
+        i1 = min(i1, end(d) - 1);
+        return (i1 >= max<ptrdiff_t>(0, -d)) ? i1 : NONE;
+    };
+
+    size_t best = limit + 1;
+    auto settle = [&](ptrdiff_t d, size_t e) {
+        ptrdiff_t i1 = end(d);
+        size_t tail = tail_cost(static_cast<int>((len1 - i1) + (len2 - d - i1)));
+        if (tail <= limit && e + tail < best) {
+            best = e + tail;
+        }
+    };
+
+    std::fill(cur, cur + num_diagonals, NONE);
+    cur[-dmin] = static_cast<ptrdiff_t>(common_prefix_length(s1, 0, s2, 0, static_cast<size_t>(end(0))));
+    if (cur[-dmin] == end(0)) {
+        settle(0, 0);
+    }
+
+    for (size_t e = 1; e < best; ++e) {
+        std::swap(cur, prev);
+        bool changed = false;
+
+        for (ptrdiff_t d = dmin; d <= dmax; ++d) {
+            size_t idx = static_cast<size_t>(d - dmin);
+            ptrdiff_t end_d = end(d);
+            if (prev[idx] == end_d) { // Terminal cell was already reached
+                cur[idx] = prev[idx];
+                continue;
+            }
+
+            ptrdiff_t i1 = (prev[idx] == NONE) ? NONE : prev[idx] + 1; // Mismatch
+            if (d > dmin) {
+                i1 = max(i1, source(prev[idx - 1], d - 1)); // Gap in s1
+            }
+            if (d < dmax) {
+                ptrdiff_t from = source(prev[idx + 1], d + 1);
+                i1 = max(i1, (from == NONE) ? NONE : from + 1); // Gap in s2
+            }
+
+            if (i1 != NONE) {
+                i1 += static_cast<ptrdiff_t>(common_prefix_length(s1, static_cast<size_t>(i1),
+                                                                  s2, static_cast<size_t>(i1 + d),
+                                                                  static_cast<size_t>(end_d - i1)));
+                if (i1 == end_d) {
+                    settle(d, e);
+                }
+            }
+            changed |= i1 != prev[idx];
+            cur[idx] = i1;
+        }
+
+        if (!changed) { // Nothing else is reachable
+            break;
+        }
+    }
+
+    return best;
+}
+
+
+// Hamming distance between common prefixes of s1 and s2. Stops as soon as the distance exceeds limit,
+// in that case some value greater than limit is returned. Packed reads provide a word-parallel overload
+template<typename Ts1, typename Ts2>
+size_t hamming_distance(const Ts1 &s1, const Ts2 &s2, size_t limit) {
+    using seqan::length;
+    size_t len = std::min<size_t>(length(s1), length(s2));
+
+    size_t res = 0;
+    for (size_t i = 0; i < len && res <= limit; ++i) {
+        res += (s1[i] == s2[i]) ? 0 : 1;
+    }
+
+    return res;
+}
+
+
+// Distance induced by half_sw_banded(s1, s2, 0, -1, -1, lizard_tail, max_indels) for tail_cost(l) = -lizard_tail(l)
+// with threshold-aware evaluation: dist_at_most(s1, s2, tau) returns the distance if it does not exceed tau and
+// tau + 1 otherwise, so that a rejected pair costs only a few word operations
+template<typename Tf>
+class HalfSWDistance {
+public:
+    HalfSWDistance(size_t max_indels, const Tf &tail_cost) : max_indels_(max_indels), tail_cost_(tail_cost) { }
+
+    template<typename Ts1, typename Ts2>
+    size_t dist_at_most(const Ts1 &s1, const Ts2 &s2, size_t tau) const {
+        using seqan::length;
+        if (max_indels_ > 0) {
+            return half_edit_dist_banded(s1, s2, tail_cost_, max_indels_, tau);
+        }
+
+        size_t dist = hamming_distance(s1, s2, tau);
+        if (dist <= tau) {
+            dist += tail_cost_(std::abs(static_cast<int>(length(s1)) - static_cast<int>(length(s2))));
+        }
+        return std::min(dist, tau + 1);
+    }
+
+    // Unbounded distance, for use as an ordinary distance functor
+    template<typename Ts1, typename Ts2>
+    size_t operator()(const Ts1 &s1, const Ts2 &s2) const {
+        return dist_at_most(s1, s2, std::numeric_limits<size_t>::max() - 1);
+    }
+
+    size_t max_indels() const { return max_indels_; }
+
+    const Tf& tail_cost() const { return tail_cost_; }
+
+private:
+    size_t max_indels_;
+    Tf tail_cost_;
+};
+
+template<typename Tf>
+HalfSWDistance<Tf> half_sw_distance(size_t max_indels, const Tf &tail_cost) {
+    return HalfSWDistance<Tf>(max_indels, tail_cost);
+}
+
+
+// dist_at_most with a fixed threshold as a binary functor. Unlike a lambda, it can be recognized by
+// verify_candidates, which checks whole candidate lists of packed reads at once (see batch_distance.hpp)
+template<typename Tf>
+class BoundedHalfSWDistance {
+public:
+    BoundedHalfSWDistance(const HalfSWDistance<Tf> &dist, size_t tau) : dist_(dist), tau_(tau) { }
+
+    template<typename Ts1, typename Ts2>
+    size_t operator()(const Ts1 &s1, const Ts2 &s2) const {
+        return dist_.dist_at_most(s1, s2, tau_);
+    }
+
+    const HalfSWDistance<Tf>& dist() const { return dist_; }
+
+    size_t tau() const { return tau_; }
+
+private:
+    const HalfSWDistance<Tf> &dist_;
+    size_t tau_;
+};
+
 // vim: ts=4:sw=4
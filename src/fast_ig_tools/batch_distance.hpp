@@ -0,0 +1,233 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <vector>
+#include <verify.hpp>
+
+#include "banded_half_smith_waterman.hpp"
+#include "packed_reads.hpp"
+
+
+// Verification of one query against many candidates with inter-sequence parallelism: every lane of
+// a vector word (GCC vector extension, lowered to whatever SIMD the target has) serves its own candidate.
+// Candidates are reads[indices[0]], ..., reads[indices[n - 1]], they are processed by blocks of kBatchLanes.
+// Results are exactly those of the scalar functions of banded_half_smith_waterman.hpp
+const size_t kBatchLanes = 16;
+
+// A block that fills fewer lanes costs the same as a full one, so a remainder of fewer candidates is compared
+// one by one
+const size_t kMinBatchLanes = kBatchLanes / 2;
+
+
+// Bounded banded half edit distances, i.e., half_edit_dist_banded(query, candidate, tail_cost, max_indels, limit).
+// Computed by the DP of half_sw_banded with saturating byte lanes. Candidates of a block are transposed,
+// so that their bases at a position form a vector, and their ends are marked by sentinels.
+// Requires limit + 2 <= 255
+template<typename Tf>
+void half_edit_dist_banded_batch(const PackedRead &query,
+                                 const PackedReadStore &reads,
+                                 const size_t *indices, size_t n,
+                                 const Tf &tail_cost,
+                                 size_t max_indels,
+                                 size_t limit,
+                                 size_t *result) {
+    typedef uint8_t Cells __attribute__((vector_size(kBatchLanes)));
+
+    VERIFY(limit + 2 <= std::numeric_limits<uint8_t>::max());
+    const uint8_t kInf = static_cast<uint8_t>(limit + 1);
+    const uint8_t kEnd = 6, kBeyond = 7; // Base codes are 0..4
+    const Cells zero = { };
+    const Cells one = zero + 1;
+    const Cells inf = zero + kInf;
+
+    auto min = [](const Cells &a, const Cells &b) -> Cells {
+        return (a < b) ? a : b;
+    };
+    auto bounded_tail = [&tail_cost, kInf](ptrdiff_t l) -> uint8_t {
+        return static_cast<uint8_t>(std::min<size_t>(tail_cost(static_cast<int>(l)), kInf));
+    };
+
+    // The same band as half_edit_dist_banded: diagonals beyond limit are useless
+    const ptrdiff_t band = static_cast<ptrdiff_t>(std::min(max_indels, limit));
+    const ptrdiff_t width = 2 * band + 1;
+    const ptrdiff_t len1 = static_cast<ptrdiff_t>(query.length());
+
+    std::vector<uint8_t> query_bases(len1);
+    for (ptrdiff_t i = 0; i < len1; ++i) {
+        query_bases[i] = static_cast<uint8_t>(seqan::ordValue(query[i]));
+    }
+
+    // A path that has not ended before row i1 either passes through row i1 or ends in one of rows [0, i1),
+    // so the minimum of a row together with the cheapest of these ends bounds the distance from below
+    std::vector<uint8_t> min_end_before(len1 + 1, kInf);
+    for (ptrdiff_t i1 = 1; i1 <= len1; ++i1) {
+        min_end_before[i1] = std::min(min_end_before[i1 - 1], bounded_tail(len1 - (i1 - 1)));
+    }
+
+    // Candidate positions i2 <= len1 + band are read by the DP. They are transposed lazily by words
+    // as rows go from the end, so that a block rejected after a few rows is not transposed in full
+    const size_t B = PackedRead::kBasesPerWord;
+    const ptrdiff_t num_positions = len1 + band + 1;
+    std::vector<Cells> columns(num_positions);
+    std::vector<Cells> row(width), next_row(width);
+
+    for (size_t begin = 0; begin < n; begin += kBatchLanes) {
+        size_t lanes = std::min(kBatchLanes, n - begin);
+
+        const uint64_t *codes[kBatchLanes] = { };
+        const uint64_t *n_masks[kBatchLanes] = { };
+        ptrdiff_t len2[kBatchLanes] = { };
+        ptrdiff_t min_len2 = std::numeric_limits<ptrdiff_t>::max();
+        for (size_t l = 0; l < lanes; ++l) {
+            PackedRead candidate = reads[indices[begin + l]];
+            codes[l] = candidate.codes();
+            n_masks[l] = candidate.n_mask();
+            len2[l] = static_cast<ptrdiff_t>(candidate.length());
+            min_len2 = std::min(min_len2, len2[l]);
+        }
+
+        // Positions [from, to) of one word
+        auto transpose = [&](ptrdiff_t from, ptrdiff_t to) {
+            size_t w = static_cast<size_t>(from) / B;
+            for (size_t l = 0; l < kBatchLanes; ++l) {
+                ptrdiff_t known = std::min(to, len2[l]);
+                if (from < known) {
+                    uint64_t word = codes[l][w];
+                    uint64_t n_mask = n_masks[l] ? n_masks[l][w] : 0;
+                    for (ptrdiff_t p = from; p < known; ++p) {
+                        size_t shift = 2 * (static_cast<size_t>(p) % B);
+                        columns[p][l] = ((n_mask >> shift) & 1) ? 4 : static_cast<uint8_t>((word >> shift) & 3);
+                    }
+                }
+                for (ptrdiff_t p = std::max(from, known); p < to; ++p) {
+                    columns[p][l] = (p == len2[l]) ? kEnd : kBeyond;
+                }
+            }
+        };
+        ptrdiff_t transposed_from = num_positions;
+
+        // Row len1: only tails are left
+        for (ptrdiff_t inx = 0; inx < width; ++inx) {
+            ptrdiff_t i2 = len1 + inx - band;
+            for (size_t l = 0; l < kBatchLanes; ++l) {
+                row[inx][l] = (i2 >= 0 && i2 <= len2[l]) ? bounded_tail(len2[l] - i2) : kInf;
+            }
+        }
+
+        // A candidate ends (i2 = len2) only in rows [len2 - band, len2 + band]
+        const ptrdiff_t first_end_row = min_len2 - band;
+
+        bool rejected = false;
+        for (ptrdiff_t i1 = len1 - 1; i1 >= 0; --i1) {
+            while (transposed_from > std::max<ptrdiff_t>(i1 - band, 0)) {
+                ptrdiff_t from = (transposed_from - 1) / static_cast<ptrdiff_t>(B) * static_cast<ptrdiff_t>(B);
+                transpose(from, transposed_from);
+                transposed_from = from;
+            }
+
+            const Cells base = zero + query_bases[i1];
+            const Cells end_cost = zero + bounded_tail(len1 - i1);
+            // Sentinels occur only in columns i2 >= min_len2
+            const bool sentinels = i1 + band >= min_len2;
+
+            Cells row_min = inf;
+            for (ptrdiff_t inx = width - 1; inx >= 0; --inx) {
+                ptrdiff_t i2 = i1 + inx - band;
+                if (i2 < 0) {
+                    next_row[inx] = inf;
+                    continue;
+                }
+
+                const Cells &column = columns[i2];
+                Cells cost = row[inx] + ((Cells)(column != base) & one); // Match or mismatch
+                if (inx > 0) {
+                    cost = min(cost, row[inx - 1] + one); // Gap in candidate
+                }
+                if (inx < width - 1) {
+                    cost = min(cost, next_row[inx + 1] + one); // Gap in query
+                }
+                cost = min(cost, inf);
+
+                if (sentinels) {
+                    cost = (column == kEnd) ? end_cost : cost;
+                    cost = (column == kBeyond) ? inf : cost;
+                }
+
+                next_row[inx] = cost;
+                row_min = min(row_min, cost);
+            }
+            std::swap(row, next_row);
+
+            if (i1 % 4 == 0 && (first_end_row >= i1 || min_end_before[i1] == kInf)) {
+                bool all_rejected = true;
+                for (size_t l = 0; l < lanes; ++l) {
+                    all_rejected &= row_min[l] == kInf;
+                }
+                if (all_rejected) {
+                    rejected = true;
+                    break;
+                }
+            }
+        }
+
+        for (size_t l = 0; l < lanes; ++l) {
+            result[begin + l] = rejected ? kInf : row[band][l];
+        }
+    }
+}
+
+
+// HalfSWDistance::dist_at_most(query, candidate, tau) for every candidate. Without indels, the word-parallel
+// Hamming distance of packed reads already compares 32 bases per operation and rejects most candidates by
+// their first words, while a block of lanes runs as long as its most similar candidate. On SSE2 the batch
+// was not faster for it, so Hamming candidates are compared one by one
+template<typename Tf>
+void dist_at_most_batch(const HalfSWDistance<Tf> &dist,
+                        const PackedRead &query,
+                        const PackedReadStore &reads,
+                        const size_t *indices, size_t n,
+                        size_t tau,
+                        size_t *result) {
+    size_t batched = 0;
+    if (dist.max_indels() > 0 && tau + 2 <= std::numeric_limits<uint8_t>::max()) {
+        batched = (n % kBatchLanes < kMinBatchLanes) ? n - n % kBatchLanes : n;
+        if (batched) {
+            half_edit_dist_banded_batch(query, reads, indices, batched, dist.tail_cost(), dist.max_indels(), tau,
+                                        result);
+        }
+    }
+
+    for (size_t k = batched; k < n; ++k) {
+        result[k] = dist.dist_at_most(query, reads[indices[k]], tau);
+    }
+}
+
+
+// Bounded distances from query to reads[indices[k]], pair by pair
+template<typename TRead, typename TReads, typename Tbounded_dist>
+void verify_candidates(const Tbounded_dist &bounded_dist,
+                       const TRead &query,
+                       const TReads &reads,
+                       const std::vector<size_t> &indices,
+                       std::vector<size_t> &dists) {
+    dists.resize(indices.size());
+    for (size_t k = 0; k < indices.size(); ++k) {
+        dists[k] = bounded_dist(query, reads[indices[k]]);
+    }
+}
+
+// The same for packed reads and HalfSWDistance, by batches
+template<typename Tf>
+void verify_candidates(const BoundedHalfSWDistance<Tf> &bounded_dist,
+                       const PackedRead &query,
+                       const PackedReadStore &reads,
+                       const std::vector<size_t> &indices,
+                       std::vector<size_t> &dists) {
+    dists.resize(indices.size());
+    dist_at_most_batch(bounded_dist.dist(), query, reads, indices.data(), indices.size(), bounded_dist.tau(),
+                       dists.data());
+}
+
+// vim: ts=4:sw=4
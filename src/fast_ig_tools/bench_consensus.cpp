@@ -0,0 +1,318 @@
+#include <boost/program_options.hpp>
+namespace po = boost::program_options;
+
+#include <iostream>
+#include <fstream>
+#include <random>
+using std::cout;
+using std::endl;
+
+#include "fast_ig_tools.hpp"
+
+#include <seqan/seq_io.h>
+using seqan::Dna5String;
+
+#include <openmp_wrapper.h>
+
+#include "ig_final_alignment.hpp"
+#include "column_profile.hpp"
+#include "utils.hpp"
+#include <build_info.hpp>
+
+
+// Benchmark of Hamming consensus of large clusters: ColumnProfile (ig_final_alignment.hpp) against profiles of
+// seqan ProfileChar built read by read, i.e., the previous implementation. Every row of the output (TSV) is one
+// benchmark, its time is the minimum and the median over repeats. Checksums of the two implementations are equal
+struct BenchParam {
+    std::string input_file = "";
+    std::string output_file = "";
+    size_t clusters = 3;
+    size_t cluster_size = 100000;
+    size_t read_length = 350;
+    size_t max_mutations = 10;
+    size_t max_abundance = 10;
+    size_t coverage_limit = 5;
+    unsigned seed = 8356;
+    size_t repeats = 3;
+};
+
+
+bool parse_cmd_line_arguments(int argc, char **argv, BenchParam &args) {
+    po::options_description generic("Generic options");
+    generic.add_options()
+            ("version,v", "print version string")
+            ("help,h", "produce help message")
+            ("input-file,i", po::value<std::string>(&args.input_file)->default_value(args.input_file),
+             "reads of one cluster (FASTA|FASTQ), abundances are taken from ___size___ of ids; "
+             "synthetic clusters are generated if it is empty")
+            ("output-file,o", po::value<std::string>(&args.output_file)->default_value(args.output_file),
+             "file for results (TSV), standard output if empty")
+            ;
+
+    po::options_description config("Configuration");
+    config.add_options()
+            ("clusters", po::value<size_t>(&args.clusters)->default_value(args.clusters),
+             "synthetic data: the number of clusters")
+            ("cluster-size", po::value<size_t>(&args.cluster_size)->default_value(args.cluster_size),
+             "synthetic data: the number of reads of a cluster")
+            ("read-length", po::value<size_t>(&args.read_length)->default_value(args.read_length),
+             "synthetic data: length of cluster sequences")
+            ("max-mutations", po::value<size_t>(&args.max_mutations)->default_value(args.max_mutations),
+             "synthetic data: maximal number of substitutions and indels in a read")
+            ("max-abundance", po::value<size_t>(&args.max_abundance)->default_value(args.max_abundance),
+             "synthetic data: abundances of reads are uniform in [1, max-abundance]")
+            ("coverage-limit,l", po::value<size_t>(&args.coverage_limit)->default_value(args.coverage_limit),
+             "coverage limit of consensus_hamming_limited_coverage")
+            ("seed", po::value<unsigned>(&args.seed)->default_value(args.seed),
+             "synthetic data: random seed")
+            ("repeats", po::value<size_t>(&args.repeats)->default_value(args.repeats),
+             "the number of runs of every benchmark")
+            ;
+
+    po::options_description visible("Allowed options");
+    visible.add(generic).add(config);
+
+    po::variables_map vm;
+    store(po::command_line_parser(argc, argv).options(visible).run(), vm);
+
+    if (vm.count("help")) {
+        cout << visible << std::endl;
+        return false;
+    }
+
+    if (vm.count("version")) {
+        cout << bformat("Consensus Benchmark, part of IgReC version %s; git version: %s") % build_info::version % build_info::git_hash7 << std::endl;
+        return false;
+    }
+
+    notify(vm);
+    return true;
+}
+
+
+// Reads of a cluster are a random sequence with substitutions and indels, the tails of some of them are cut
+void synthetic_clusters(const BenchParam &args,
+                        std::vector<Dna5String> &reads,
+                        std::vector<std::vector<size_t>> &clusters,
+                        std::vector<size_t> &abundances) {
+    std::mt19937 rnd(args.seed);
+    const std::string alphabet = "ACGT";
+    for (size_t c = 0; c < args.clusters; ++c) {
+        std::string base;
+        for (size_t i = 0; i < args.read_length; ++i) {
+            base += alphabet[rnd() % 4];
+        }
+
+        clusters.push_back({});
+        for (size_t m = 0; m < args.cluster_size; ++m) {
+            std::string read = base;
+            size_t mutations = rnd() % (args.max_mutations + 1);
+            for (size_t i = 0; i < mutations && !read.empty(); ++i) {
+                size_t pos = rnd() % read.size();
+                switch (rnd() % 4) {
+                    case 0: read.erase(pos, 1); break;
+                    case 1: read.insert(pos, 1, alphabet[rnd() % 4]); break;
+                    default: read[pos] = alphabet[rnd() % 4];
+                }
+            }
+            if (rnd() % 4 == 0) {
+                read.resize(read.size() - std::min<size_t>(read.size(), rnd() % 20));
+            }
+            clusters.back().push_back(reads.size());
+            reads.push_back(Dna5String(read));
+            abundances.push_back(1 + rnd() % std::max<size_t>(args.max_abundance, 1));
+        }
+    }
+}
+
+
+// The previous implementations, profiles of seqan ProfileChar counted read by read and base by base
+seqan::String<seqan::Dna5> consensus_hamming_seqan(const std::vector<Dna5String> &reads,
+                                                   const std::vector<size_t> &indices) {
+    using namespace seqan;
+    String<ProfileChar<Dna5>> profile;
+
+    size_t len = 0;
+    for (size_t i : indices) {
+        len = std::max(len, length(reads[i]));
+    }
+
+    resize(profile, len);
+
+    for (size_t i : indices) {
+        const auto &read = reads[i];
+        for (size_t j = 0; j < length(read); ++j) {
+            profile[j].count[ordValue(read[j])] += 1;
+        }
+    }
+
+    Dna5String consensus;
+    for (size_t i = 0; i < length(profile); ++i) {
+        size_t idx = getMaxIndex(profile[i]);
+        if (idx < ValueSize<Dna5>::VALUE) {
+            appendValue(consensus, Dna5(idx));
+        }
+    }
+
+    return consensus;
+}
+
+seqan::String<seqan::Dna5> consensus_hamming_limited_coverage_seqan(const std::vector<Dna5String> &reads,
+                                                                    const std::vector<size_t> &indices,
+                                                                    const std::vector<size_t> &abundances,
+                                                                    size_t coverage_limit) {
+    using namespace seqan;
+    size_t len = 0;
+    for (size_t i : indices) {
+        len = std::max(len, length(reads[i]));
+    }
+
+    String<ProfileChar<Dna5>> profile;
+    resize(profile, len);
+    std::vector<size_t> coverage(len);
+
+    for (size_t i : indices) {
+        const auto &read = reads[i];
+        for (size_t j = 0; j < length(read); ++j) {
+            profile[j].count[ordValue(read[j])] += static_cast<unsigned>(abundances[i]);
+            coverage[j] += abundances[i];
+        }
+    }
+
+    coverage_limit = std::min(coverage_limit, coverage[0]);
+
+    Dna5String consensus;
+    for (size_t i = 0; i < len; ++i) {
+        if (coverage[i] < coverage_limit) break;
+
+        size_t idx = getMaxIndex(profile[i]);
+        if (idx < ValueSize<Dna5>::VALUE) {
+            appendValue(consensus, Dna5(idx));
+        }
+    }
+
+    return consensus;
+}
+
+
+size_t checksum(const Dna5String &consensus) {
+    size_t result = seqan::length(consensus);
+    for (size_t i = 0; i < seqan::length(consensus); ++i) {
+        result = result * 31 + seqan::ordValue(consensus[i]);
+    }
+    return result;
+}
+
+
+class BenchWriter {
+public:
+    BenchWriter(std::ostream &out, const std::string &dataset, size_t num_reads, size_t repeats) :
+            out_(out), dataset_(dataset), num_reads_(num_reads), repeats_(repeats) {
+        out_ << "version\tdataset\treads\tbenchmark\timplementation\t"
+                "items\trepeats\tmin_seconds\tmedian_seconds\titems_per_second\tchecksum" << endl;
+    }
+
+    // f() returns the checksum
+    template<typename F>
+    void run(const std::string &benchmark, const std::string &implementation, size_t items, const F &f) {
+        std::vector<double> times;
+        size_t checksum = 0;
+        for (size_t r = 0; r < std::max<size_t>(repeats_, 1); ++r) {
+            double start = omp_get_wtime();
+            checksum = f();
+            times.push_back(omp_get_wtime() - start);
+        }
+        std::sort(times.begin(), times.end());
+        double median = times[times.size() / 2];
+
+        out_ << build_info::git_hash7 << "\t" << dataset_ << "\t" << num_reads_ << "\t" << benchmark
+             << "\t" << implementation << "\t" << items << "\t" << times.size() << "\t" << times.front()
+             << "\t" << median << "\t" << (times.front() > 0 ? static_cast<double>(items) / times.front() : 0.)
+             << "\t" << checksum << endl;
+    }
+
+private:
+    std::ostream &out_;
+    std::string dataset_;
+    size_t num_reads_;
+    size_t repeats_;
+};
+
+
+int main(int argc, char **argv) {
+    segfault_handler sh;
+    create_console_logger("");
+
+    BenchParam args;
+    try {
+        if (!parse_cmd_line_arguments(argc, argv, args)) {
+            return 0;
+        }
+    } catch(std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    INFO("Command line: " << join_cmd_line(argc, argv));
+    std::vector<Dna5String> reads;
+    std::vector<std::vector<size_t>> clusters;
+    std::vector<size_t> abundances;
+    std::string dataset;
+    if (args.input_file != "") {
+        std::vector<seqan::CharString> input_ids;
+        seqan::SeqFileIn seqFileIn_input(args.input_file.c_str());
+        readRecords(input_ids, reads, seqFileIn_input);
+        abundances = find_abundances(input_ids);
+        clusters.push_back(std::vector<size_t>(reads.size()));
+        std::iota(clusters.back().begin(), clusters.back().end(), 0);
+        dataset = args.input_file;
+        INFO(reads.size() << " reads were extracted from " << args.input_file);
+    } else {
+        synthetic_clusters(args, reads, clusters, abundances);
+        dataset = (bformat("synthetic:%d:%d:%d:%d:%d:%d") % args.clusters % args.cluster_size % args.read_length
+                   % args.max_mutations % args.max_abundance % args.seed).str();
+        INFO(reads.size() << " synthetic reads were generated");
+    }
+
+    std::ofstream file_out;
+    if (args.output_file != "") {
+        file_out.open(args.output_file);
+        VERIFY_MSG(file_out, "Cannot open " << args.output_file);
+    }
+    BenchWriter writer(args.output_file != "" ? file_out : cout, dataset, reads.size(), args.repeats);
+
+    writer.run("consensus_hamming", "seqan", reads.size(), [&]() -> size_t {
+        size_t total = 0;
+        for (const auto &cluster : clusters) {
+            total += checksum(consensus_hamming_seqan(reads, cluster));
+        }
+        return total;
+    });
+    writer.run("consensus_hamming", "column_profile", reads.size(), [&]() -> size_t {
+        size_t total = 0;
+        for (const auto &cluster : clusters) {
+            total += checksum(consensus_hamming(reads, cluster));
+        }
+        return total;
+    });
+
+    writer.run("consensus_hamming_limited_coverage", "seqan", reads.size(), [&]() -> size_t {
+        size_t total = 0;
+        for (const auto &cluster : clusters) {
+            total += checksum(consensus_hamming_limited_coverage_seqan(reads, cluster, abundances,
+                                                                       args.coverage_limit));
+        }
+        return total;
+    });
+    writer.run("consensus_hamming_limited_coverage", "column_profile", reads.size(), [&]() -> size_t {
+        size_t total = 0;
+        for (const auto &cluster : clusters) {
+            total += checksum(consensus_hamming_limited_coverage(reads, cluster, abundances, args.coverage_limit));
+        }
+        return total;
+    });
+
+    return 0;
+}
+
+// vim: ts=4:sw=4
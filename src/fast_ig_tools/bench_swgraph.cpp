@@ -0,0 +1,444 @@
+#include <boost/program_options.hpp>
+namespace po = boost::program_options;
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <random>
+using std::cout;
+using std::cerr;
+using std::endl;
+
+#include "fast_ig_tools.hpp"
+
+#include <seqan/seq_io.h>
+using seqan::Dna5String;
+
+#include <openmp_wrapper.h>
+
+#include "ig_matcher.hpp"
+#include "packed_reads.hpp"
+#include "banded_half_smith_waterman.hpp"
+#include "batch_distance.hpp"
+#include "utils.hpp"
+#include <build_info.hpp>
+
+
+// Benchmark of ig_swgraph_construct components. Every row of the output (TSV) is one benchmark with one set of
+// parameters, its time is the minimum and the median over repeats. The checksum column depends only on the data
+// and parameters, so that rows of different versions are comparable only if their checksums are equal
+struct BenchParam {
+    std::string input_file = "";
+    std::string output_file = "";
+    size_t clones = 100;
+    size_t clone_size = 20;
+    size_t read_length = 350;
+    size_t max_mutations = 10;
+    unsigned seed = 8356;
+    std::string strategies = "0,1,2,3";
+    std::string ks = "8,10,12";
+    std::string taus = "2,4";
+    std::string max_indels = "0,2";
+    std::string layouts = "packed";
+    std::string components = "index,candidates,kernels,graph";
+    size_t max_pairs = 200000;
+    size_t repeats = 3;
+    unsigned nthreads = 1;
+};
+
+
+std::vector<unsigned> parse_list(const std::string &s) {
+    std::vector<unsigned> values;
+    std::istringstream ss(s);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        values.push_back(static_cast<unsigned>(std::stoul(item)));
+    }
+    return values;
+}
+
+std::vector<std::string> parse_names(const std::string &s) {
+    std::vector<std::string> names;
+    std::istringstream ss(s);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        names.push_back(item);
+    }
+    return names;
+}
+
+
+bool parse_cmd_line_arguments(int argc, char **argv, BenchParam &args) {
+    po::options_description generic("Generic options");
+    generic.add_options()
+            ("version,v", "print version string")
+            ("help,h", "produce help message")
+            ("input-file,i", po::value<std::string>(&args.input_file)->default_value(args.input_file),
+             "repertoire (FASTA|FASTQ), e.g. test_dataset/merged_reads.fastq or output of simulate_barcoded "
+             "or simulate_tiny_dataset; synthetic clones are generated if it is empty")
+            ("output-file,o", po::value<std::string>(&args.output_file)->default_value(args.output_file),
+             "file for results (TSV), standard output if empty")
+            ;
+
+    po::options_description config("Configuration");
+    config.add_options()
+            ("clones", po::value<size_t>(&args.clones)->default_value(args.clones),
+             "synthetic data: the number of clones")
+            ("clone-size", po::value<size_t>(&args.clone_size)->default_value(args.clone_size),
+             "synthetic data: mean clone size, sizes are uniform in [1, 2 * clone-size - 1]")
+            ("read-length", po::value<size_t>(&args.read_length)->default_value(args.read_length),
+             "synthetic data: length of clone sequences")
+            ("max-mutations", po::value<size_t>(&args.max_mutations)->default_value(args.max_mutations),
+             "synthetic data: maximal number of substitutions and indels in a read of a clone")
+            ("seed", po::value<unsigned>(&args.seed)->default_value(args.seed),
+             "synthetic data: random seed")
+            ("strategies,S", po::value<std::string>(&args.strategies)->default_value(args.strategies),
+             "comma-separated strategies (0 --- naive, 1 --- single, 2 --- pair, 3 --- triple, etc)")
+            ("word-sizes,k", po::value<std::string>(&args.ks)->default_value(args.ks),
+             "comma-separated word sizes")
+            ("tau", po::value<std::string>(&args.taus)->default_value(args.taus),
+             "comma-separated maximal distances")
+            ("max-indels", po::value<std::string>(&args.max_indels)->default_value(args.max_indels),
+             "comma-separated maximal numbers of indels")
+            ("layouts", po::value<std::string>(&args.layouts)->default_value(args.layouts),
+             "comma-separated read layouts for candidates and graph benchmarks: packed (PackedReadStore) "
+             "and seqan (std::vector<Dna5String>)")
+            ("components", po::value<std::string>(&args.components)->default_value(args.components),
+             "comma-separated benchmarks: index (k-mer index build), candidates (find_candidates), "
+             "kernels (half_hamming, half_sw_banded, dist_at_most, dist_at_most_batch on candidate pairs) "
+             "and graph (tauDistGraph end-to-end)")
+            ("max-pairs", po::value<size_t>(&args.max_pairs)->default_value(args.max_pairs),
+             "the maximal number of candidate pairs for kernel benchmarks")
+            ("repeats", po::value<size_t>(&args.repeats)->default_value(args.repeats),
+             "the number of runs of every benchmark")
+            ("threads,t", po::value<unsigned>(&args.nthreads)->default_value(args.nthreads),
+             "the number of parallel threads")
+            ;
+
+    po::options_description visible("Allowed options");
+    visible.add(generic).add(config);
+
+    po::variables_map vm;
+    store(po::command_line_parser(argc, argv).options(visible).run(), vm);
+
+    if (vm.count("help")) {
+        cout << visible << std::endl;
+        return false;
+    }
+
+    if (vm.count("version")) {
+        cout << bformat("S-W Graph Benchmark, part of IgReC version %s; git version: %s") % build_info::version % build_info::git_hash7 << std::endl;
+        return false;
+    }
+
+    notify(vm);
+    return true;
+}
+
+
+// Clones of random sequences with substitutions and indels, shuffled. Like simulate_tiny_dataset,
+// but clone sizes differ, as in real repertoires
+std::vector<Dna5String> synthetic_repertoire(const BenchParam &args) {
+    std::mt19937 rnd(args.seed);
+    const std::string alphabet = "ACGT";
+    std::vector<Dna5String> reads;
+    for (size_t c = 0; c < args.clones; ++c) {
+        std::string base;
+        for (size_t i = 0; i < args.read_length; ++i) {
+            base += alphabet[rnd() % 4];
+        }
+
+        size_t clone_size = 1 + rnd() % std::max<size_t>(2 * args.clone_size - 1, 1);
+        for (size_t m = 0; m < clone_size; ++m) {
+            std::string read = base;
+            size_t mutations = rnd() % (args.max_mutations + 1);
+            for (size_t i = 0; i < mutations && !read.empty(); ++i) {
+                size_t pos = rnd() % read.size();
+                switch (rnd() % 4) {
+                    case 0: read.erase(pos, 1); break;
+                    case 1: read.insert(pos, 1, alphabet[rnd() % 4]); break;
+                    default: read[pos] = alphabet[rnd() % 4];
+                }
+            }
+            reads.push_back(Dna5String(read));
+        }
+    }
+    std::shuffle(reads.begin(), reads.end(), rnd);
+    return reads;
+}
+
+
+class BenchWriter {
+public:
+    BenchWriter(std::ostream &out, const std::string &dataset, size_t num_reads, size_t repeats) :
+            out_(out), dataset_(dataset), num_reads_(num_reads), repeats_(repeats) {
+        out_ << "version\tdataset\treads\tthreads\tbenchmark\tlayout\tstrategy\tk\ttau\tmax_indels\t"
+                "items\trepeats\tmin_seconds\tmedian_seconds\titems_per_second\tchecksum" << endl;
+    }
+
+    // Parameters that do not apply to a benchmark are -1. f() returns the checksum
+    template<typename F>
+    void run(const std::string &benchmark, const std::string &layout,
+             int strategy, int K, int tau, int max_indels,
+             size_t items, const F &f) {
+        std::vector<double> times;
+        size_t checksum = 0;
+        for (size_t r = 0; r < std::max<size_t>(repeats_, 1); ++r) {
+            double start = omp_get_wtime();
+            checksum = f();
+            times.push_back(omp_get_wtime() - start);
+        }
+        std::sort(times.begin(), times.end());
+        double median = times[times.size() / 2];
+
+        out_ << build_info::git_hash7 << "\t" << dataset_ << "\t" << num_reads_ << "\t" << omp_get_max_threads()
+             << "\t" << benchmark << "\t" << layout << "\t" << strategy << "\t" << K << "\t" << tau
+             << "\t" << max_indels << "\t" << items << "\t" << times.size() << "\t" << times.front()
+             << "\t" << median << "\t" << (times.front() > 0 ? items / times.front() : 0.)
+             << "\t" << checksum << endl;
+    }
+
+private:
+    std::ostream &out_;
+    std::string dataset_;
+    size_t num_reads_;
+    size_t repeats_;
+};
+
+
+// Candidate lists oriented as in tauDistGraph, at most max_pairs pairs in total
+struct CandidatePairs {
+    std::vector<size_t> queries;
+    std::vector<std::vector<size_t>> candidates;
+    size_t size = 0;
+};
+
+CandidatePairs candidate_pairs(const PackedReadStore &reads, const KmerIndex &kmer2reads,
+                               unsigned tau, unsigned K, unsigned strategy, size_t max_pairs) {
+    CandidatePairs pairs;
+    CandidateScratch scratch;
+    for (size_t j = 0; j < reads.size() && pairs.size < max_pairs; ++j) {
+        size_t len_j = reads[j].length();
+        std::vector<size_t> oriented;
+        for (size_t i : find_candidates(reads[j], kmer2reads, reads.size(), tau, K, strategy, scratch)) {
+            size_t len_i = reads[i].length();
+            if ((len_j < len_i || (len_i == len_j && j < i)) && pairs.size < max_pairs) {
+                oriented.push_back(i);
+                ++pairs.size;
+            }
+        }
+        if (!oriented.empty()) {
+            pairs.queries.push_back(j);
+            pairs.candidates.push_back(std::move(oriented));
+        }
+    }
+    return pairs;
+}
+
+
+template<typename TReads>
+void bench_candidates(BenchWriter &writer, const std::string &layout, const TReads &reads,
+                      const KmerIndex &kmer2reads, unsigned strategy, unsigned K, unsigned tau) {
+    writer.run("find_candidates", layout, strategy, K, tau, -1, reads.size(), [&]() -> size_t {
+        size_t total = 0;
+        SEQAN_OMP_PRAGMA(parallel)
+        {
+            CandidateScratch scratch;
+            SEQAN_OMP_PRAGMA(for schedule(dynamic, 8) reduction(+:total))
+            for (size_t j = 0; j < reads.size(); ++j) {
+                total += find_candidates(reads[j], kmer2reads, reads.size(), tau, K, strategy, scratch).size();
+            }
+        }
+        return total;
+    });
+}
+
+
+template<typename TReads, typename Tf>
+void bench_graph(BenchWriter &writer, const std::string &layout, const TReads &reads,
+                 const KmerIndex &kmer2reads, const HalfSWDistance<Tf> &dist,
+                 unsigned strategy, unsigned K, unsigned tau) {
+    writer.run("tauDistGraph", layout, strategy, K, tau, static_cast<int>(dist.max_indels()), reads.size(),
+               [&]() -> size_t {
+                   size_t num_of_dist_computations;
+                   auto graph = tauDistGraph(reads, kmer2reads, dist, tau, K, strategy, num_of_dist_computations);
+                   return numEdges(graph);
+               });
+}
+
+
+template<typename Tf>
+void bench_kernels(BenchWriter &writer, const PackedReadStore &packed, const std::vector<Dna5String> &reads,
+                   const CandidatePairs &pairs, const Tf &tail_cost,
+                   unsigned strategy, unsigned K, unsigned tau, const std::vector<unsigned> &all_max_indels) {
+    auto tail_score = [&tail_cost](int l) -> int { return -static_cast<int>(tail_cost(l)); };
+
+    // Reference implementations on seqan strings, unbounded. Pairs are candidates for strategy, K and tau
+    writer.run("half_hamming", "seqan", strategy, K, tau, 0, pairs.size, [&]() -> size_t {
+        size_t total = 0;
+        for (size_t q = 0; q < pairs.queries.size(); ++q) {
+            const auto &query = reads[pairs.queries[q]];
+            for (size_t i : pairs.candidates[q]) {
+                total -= half_hamming(query, reads[i], 0, -1, tail_score);
+            }
+        }
+        return total;
+    });
+
+    for (unsigned max_indels : all_max_indels) {
+        if (max_indels == 0) {
+            continue;
+        }
+        writer.run("half_sw_banded", "seqan", strategy, K, tau, max_indels, pairs.size, [&]() -> size_t {
+            size_t total = 0;
+            for (size_t q = 0; q < pairs.queries.size(); ++q) {
+                const auto &query = reads[pairs.queries[q]];
+                for (size_t i : pairs.candidates[q]) {
+                    total -= half_sw_banded(query, reads[i], 0, -1, -1, tail_score, max_indels);
+                }
+            }
+            return total;
+        });
+    }
+
+    // Bounded distances of ig_swgraph_construct on packed reads, pair by pair and by batches
+    for (unsigned max_indels : all_max_indels) {
+        auto dist = half_sw_distance(max_indels, tail_cost);
+        writer.run("dist_at_most", "packed", strategy, K, tau, max_indels, pairs.size, [&]() -> size_t {
+            size_t total = 0;
+            for (size_t q = 0; q < pairs.queries.size(); ++q) {
+                auto query = packed[pairs.queries[q]];
+                for (size_t i : pairs.candidates[q]) {
+                    total += dist.dist_at_most(query, packed[i], tau);
+                }
+            }
+            return total;
+        });
+
+        writer.run("dist_at_most_batch", "packed", strategy, K, tau, max_indels, pairs.size, [&]() -> size_t {
+            size_t total = 0;
+            std::vector<size_t> dists;
+            for (size_t q = 0; q < pairs.queries.size(); ++q) {
+                const auto &candidates = pairs.candidates[q];
+                dists.resize(candidates.size());
+                dist_at_most_batch(dist, packed[pairs.queries[q]], packed, candidates.data(), candidates.size(),
+                                   tau, dists.data());
+                total = std::accumulate(dists.cbegin(), dists.cend(), total);
+            }
+            return total;
+        });
+    }
+}
+
+
+int main(int argc, char **argv) {
+    segfault_handler sh;
+    create_console_logger("");
+
+    BenchParam args;
+    try {
+        if (!parse_cmd_line_arguments(argc, argv, args)) {
+            return 0;
+        }
+    } catch(std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    std::vector<unsigned> strategies, ks, taus, all_max_indels;
+    try {
+        strategies = parse_list(args.strategies);
+        ks = parse_list(args.ks);
+        taus = parse_list(args.taus);
+        all_max_indels = parse_list(args.max_indels);
+    } catch (std::exception &e) {
+        std::cerr << "Wrong list of values: " << e.what() << std::endl;
+        return 1;
+    }
+    auto layouts = parse_names(args.layouts);
+    auto components = parse_names(args.components);
+    auto enabled = [&components](const std::string &component) {
+        return std::find(components.cbegin(), components.cend(), component) != components.cend();
+    };
+    for (const auto &layout : layouts) {
+        if (layout != "packed" && layout != "seqan") {
+            std::cerr << "Unknown layout " << layout << ", expected packed or seqan" << std::endl;
+            return 1;
+        }
+    }
+
+    omp_set_num_threads(args.nthreads);
+
+    INFO("Command line: " << join_cmd_line(argc, argv));
+    std::vector<Dna5String> reads;
+    std::string dataset;
+    if (args.input_file != "") {
+        std::vector<seqan::CharString> input_ids;
+        seqan::SeqFileIn seqFileIn_input(args.input_file.c_str());
+        readRecords(input_ids, reads, seqFileIn_input);
+        dataset = args.input_file;
+        INFO(reads.size() << " reads were extracted from " << args.input_file);
+    } else {
+        reads = synthetic_repertoire(args);
+        dataset = (bformat("synthetic:%d:%d:%d:%d:%d") % args.clones % args.clone_size % args.read_length
+                   % args.max_mutations % args.seed).str();
+        INFO(reads.size() << " synthetic reads were generated");
+    }
+    PackedReadStore packed(reads);
+
+    std::ofstream file_out;
+    if (args.output_file != "") {
+        file_out.open(args.output_file);
+        VERIFY_MSG(file_out, "Cannot open " << args.output_file);
+    }
+    BenchWriter writer(args.output_file != "" ? file_out : cout, dataset, reads.size(), args.repeats);
+
+    // Distances of ig_swgraph_construct with default options (tails are ignored)
+    auto tail_cost = [](int) -> size_t { return 0; };
+
+    for (unsigned K : ks) {
+        INFO("k = " << K);
+        if (enabled("index")) {
+            writer.run("index_build", "packed", -1, K, -1, -1, packed.size(), [&]() -> size_t {
+                return kmerIndexConstruction(packed, K).num_postings();
+            });
+        }
+
+        KmerIndex kmer2reads = kmerIndexConstruction(packed, K);
+        for (unsigned strategy : strategies) {
+            for (unsigned tau : taus) {
+                for (const auto &layout : layouts) {
+                    if (enabled("candidates")) {
+                        if (layout == "packed") {
+                            bench_candidates(writer, layout, packed, kmer2reads, strategy, K, tau);
+                        } else {
+                            bench_candidates(writer, layout, reads, kmer2reads, strategy, K, tau);
+                        }
+                    }
+                }
+
+                if (enabled("kernels")) {
+                    auto pairs = candidate_pairs(packed, kmer2reads, tau, K, strategy, args.max_pairs);
+                    bench_kernels(writer, packed, reads, pairs, tail_cost, strategy, K, tau, all_max_indels);
+                }
+
+                if (enabled("graph")) {
+                    for (unsigned max_indels : all_max_indels) {
+                        auto dist = half_sw_distance(max_indels, tail_cost);
+                        for (const auto &layout : layouts) {
+                            if (layout == "packed") {
+                                bench_graph(writer, layout, packed, kmer2reads, dist, strategy, K, tau);
+                            } else {
+                                bench_graph(writer, layout, reads, kmer2reads, dist, strategy, K, tau);
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    return 0;
+}
+
+// vim: ts=4:sw=4
@@ -0,0 +1,287 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include <verify.hpp>
+
+#include <seqan/sequence.h>
+
+
+// Letter counts of columns of reads aligned at their starts, i.e., String<ProfileChar<T>> over ungapped reads,
+// stored transposed: columns are taken by blocks of kProfileLanes and every block keeps a count vector per letter
+// (GCC vector extension, lowered to whatever SIMD the target has). Reads are counted block by block, a comparison
+// of their letters with a letter gives a lane mask, and the most frequent letters of a block are a vector argmax.
+// Counts are weighted (e.g., by read abundances) and unsigned as in ProfileChar. Reads of small weights are
+// first counted in byte lanes, which are added to the counts before their sum of weights could overflow a byte
+const size_t kProfileLanes = 16;
+
+template<typename T = seqan::Dna5>
+class ColumnProfile {
+public:
+    typedef uint32_t Count;
+
+    ColumnProfile() = default;
+
+    ColumnProfile(const std::vector<seqan::String<T>> &reads, const std::vector<size_t> &indices) {
+        add(reads, indices);
+    }
+
+    // weights are indexed by reads indices
+    ColumnProfile(const std::vector<seqan::String<T>> &reads,
+                  const std::vector<size_t> &indices,
+                  const std::vector<size_t> &weights) {
+        add(reads, indices, weights);
+    }
+
+    void add(const std::vector<seqan::String<T>> &reads, const std::vector<size_t> &indices) {
+        add(reads, indices, [](size_t) -> size_t { return 1; });
+    }
+
+    void add(const std::vector<seqan::String<T>> &reads,
+             const std::vector<size_t> &indices,
+             const std::vector<size_t> &weights) {
+        add(reads, indices, [&weights](size_t i) -> size_t { return weights[i]; });
+    }
+
+    // other is a profile of a subset of reads
+    void subtract(const ColumnProfile &other) {
+        VERIFY(other.size_ <= size_ && other.counts_.size() <= counts_.size());
+        for (size_t k = 0; k < other.counts_.size(); k += kProfileLanes) {
+            Counts counts, other_counts;
+            load(counts, &counts_[k]);
+            load(other_counts, &other.counts_[k]);
+            store(&counts_[k], counts - other_counts);
+        }
+        size_ -= other.size_;
+        weight_ -= other.weight_;
+
+        // Trailing columns of reads that were subtracted
+        while (length_ > 0 && coverage(length_ - 1) == 0) {
+            --length_;
+        }
+        resize(length_);
+    }
+
+    // The number of reads
+    size_t size() const {
+        return size_;
+    }
+
+    // The sum of weights of reads
+    size_t weight() const {
+        return weight_;
+    }
+
+    // The length of the longest read
+    size_t length() const {
+        return length_;
+    }
+
+    Count count(size_t j, size_t letter) const {
+        return counts_[(j / kProfileLanes * card + letter) * kProfileLanes + j % kProfileLanes];
+    }
+
+    size_t coverage(size_t j) const {
+        size_t result = 0;
+        for (size_t letter = 0; j < length_ && letter < card; ++letter) {
+            result += count(j, letter);
+        }
+        return result;
+    }
+
+    // The first column of coverage less than min_coverage
+    size_t covered_length(size_t min_coverage) const {
+        size_t j = 0;
+        while (j < length_ && coverage(j) >= min_coverage) {
+            ++j;
+        }
+        return j;
+    }
+
+    // The length of the shortest read (if weights are positive)
+    size_t min_length() const {
+        return covered_length(weight_);
+    }
+
+    // The most frequent letter of every column of the first len ones, the first one of equally frequent letters
+    // (as getMaxIndex)
+    seqan::String<T> consensus(size_t len) const {
+        VERIFY(len <= length_);
+        seqan::String<T> result;
+        seqan::resize(result, len);
+        for (size_t block = 0; block * kProfileLanes < len; ++block) {
+            const Count *counts = &counts_[block * card * kProfileLanes];
+            Counts best, current;
+            load(best, counts);
+            Counts argmax = { };
+            for (size_t letter = 1; letter < card; ++letter) {
+                load(current, counts + letter * kProfileLanes);
+                auto greater = current > best;
+                best = greater ? current : best;
+                argmax = greater ? Counts{ } + static_cast<Count>(letter) : argmax;
+            }
+            for (size_t k = 0; k < kProfileLanes && block * kProfileLanes + k < len; ++k) {
+                result[block * kProfileLanes + k] = T(argmax[k]);
+            }
+        }
+
+        return result;
+    }
+
+    seqan::String<T> consensus() const {
+        return consensus(length_);
+    }
+
+private:
+    static const size_t card = seqan::ValueSize<T>::VALUE;
+    static const size_t kMaxPendingWeight = 255;
+
+    typedef Count Counts __attribute__((vector_size(kProfileLanes * sizeof(Count))));
+    typedef uint8_t Letters __attribute__((vector_size(kProfileLanes)));
+
+    static_assert(sizeof(T) == 1, "letters of reads must be bytes");
+    static_assert(card < kMaxPendingWeight, "letters must fit a byte lane");
+
+    std::vector<Count> counts_;     // (block, letter, lane)
+    std::vector<uint8_t> pending_;  // The same layout, counts in byte lanes that are not in counts_ yet
+    size_t pending_weight_ = 0;
+    size_t length_ = 0;
+    size_t size_ = 0;
+    size_t weight_ = 0;
+
+    // Vectors are copied to and from plain arrays, so that they need no more alignment than the arrays have
+    static void load(Counts &result, const Count *p) {
+        std::memcpy(&result, p, sizeof(result));
+    }
+
+    static void store(Count *p, const Counts &value) {
+        std::memcpy(p, &value, sizeof(value));
+    }
+
+    void resize(size_t len) {
+        size_t num_blocks = (len + kProfileLanes - 1) / kProfileLanes;
+        counts_.resize(num_blocks * card * kProfileLanes, 0);
+        pending_.resize(num_blocks * card * kProfileLanes, 0);
+    }
+
+    // Reads are counted by groups, so that pending counts of a block are loaded and stored once per group
+    template<typename Tf>
+    void add(const std::vector<seqan::String<T>> &reads, const std::vector<size_t> &indices, const Tf &weight_of) {
+        Group group;
+        for (size_t i : indices) {
+            const auto &read = reads[i];
+            const size_t len = seqan::length(read);
+            const size_t weight = weight_of(i);
+            if (len > length_) {
+                length_ = len;
+                resize(length_);
+            }
+            ++size_;
+            weight_ += weight;
+            if (len == 0) {
+                continue;
+            }
+
+            const uint8_t *letters = reinterpret_cast<const uint8_t*>(&read[0]);
+            if (weight > kMaxPendingWeight) {
+                for (size_t j = 0; j < len; ++j) {
+                    counts_[(j / kProfileLanes * card + letters[j]) * kProfileLanes + j % kProfileLanes] +=
+                        static_cast<Count>(weight);
+                }
+                continue;
+            }
+
+            if (pending_weight_ + weight > kMaxPendingWeight) {
+                add_group(group);
+                flush();
+            }
+            pending_weight_ += weight;
+            group.letters[group.size] = letters;
+            group.lengths[group.size] = len;
+            group.weights[group.size] = static_cast<uint8_t>(weight);
+            if (++group.size == kGroupSize) {
+                add_group(group);
+            }
+        }
+        add_group(group);
+        flush();
+    }
+
+    static const size_t kGroupSize = 8;
+
+    struct Group {
+        const uint8_t *letters[kGroupSize];
+        size_t lengths[kGroupSize];
+        uint8_t weights[kGroupSize];
+        size_t size = 0;
+    };
+
+    void add_group(Group &group) {
+        const Letters zero = { };
+        Letters letter_vectors[card];
+        for (size_t letter = 0; letter < card; ++letter) {
+            letter_vectors[letter] = zero + static_cast<uint8_t>(letter);
+        }
+
+        size_t max_length = 0;
+        for (size_t r = 0; r < group.size; ++r) {
+            max_length = std::max(max_length, group.lengths[r]);
+        }
+
+        uint8_t *pending = pending_.data();
+        for (size_t j = 0; j < max_length; j += kProfileLanes, pending += card * kProfileLanes) {
+            Letters counts[card];
+            std::memcpy(counts, pending, sizeof(counts));
+            for (size_t r = 0; r < group.size; ++r) {
+                const size_t len = group.lengths[r];
+                if (j >= len) {
+                    continue;
+                }
+
+                Letters block_letters;
+                if (j + kProfileLanes <= len) {
+                    std::memcpy(&block_letters, group.letters[r] + j, sizeof(block_letters));
+                } else {
+                    // Lanes beyond the read match no letter
+                    block_letters = zero + static_cast<uint8_t>(card);
+                    for (size_t k = 0; j + k < len; ++k) {
+                        block_letters[k] = group.letters[r][j + k];
+                    }
+                }
+
+                // Lanes of masks are 0 or -1
+                if (group.weights[r] == 1) {
+                    for (size_t letter = 0; letter < card; ++letter) {
+                        counts[letter] -= (Letters)(block_letters == letter_vectors[letter]);
+                    }
+                } else {
+                    const Letters w = zero + group.weights[r];
+                    for (size_t letter = 0; letter < card; ++letter) {
+                        counts[letter] += (Letters)(block_letters == letter_vectors[letter]) & w;
+                    }
+                }
+            }
+            std::memcpy(pending, counts, sizeof(counts));
+        }
+        group.size = 0;
+    }
+
+    void flush() {
+        if (pending_weight_ == 0) {
+            return;
+        }
+        for (size_t k = 0; k < counts_.size(); k += kProfileLanes) {
+            Letters pending;
+            std::memcpy(&pending, &pending_[k], sizeof(pending));
+            Counts counts;
+            load(counts, &counts_[k]);
+            store(&counts_[k], counts + __builtin_convertvector(pending, Counts));
+        }
+        std::fill(pending_.begin(), pending_.end(), 0);
+        pending_weight_ = 0;
+    }
+};
+
+// vim: ts=4:sw=4
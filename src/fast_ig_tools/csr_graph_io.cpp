@@ -0,0 +1,278 @@
+#include <algorithm>
+#include <fstream>
+#include <memory>
+#include <queue>
+#include <tuple>
+#include <verify.hpp>
+#include <openmp_wrapper.h>
+#include <seqan/parallel.h>
+
+#include "csr_graph_io.hpp"
+#include "../graph_utils/crs_matrix.hpp"
+
+SparseGraphPtr to_sparse_graph(const CsrGraph &graph, std::vector<size_t> weights) {
+    size_t N = graph.size();
+    std::vector<size_t> row_index(N + 1, 0), row_index_t(N + 1, 0);
+    for (size_t v = 0; v < N; ++v) {
+        size_t lower = std::lower_bound(graph[v].begin(), graph[v].end(), CsrGraph::Edge(v, 0)) - graph[v].begin();
+        row_index_t[v + 1] = row_index_t[v] + lower;
+        row_index[v + 1] = row_index[v] + graph[v].size() - lower;
+    }
+
+    std::vector<size_t> col(row_index[N]), dist(row_index[N]), col_t(row_index_t[N]), dist_t(row_index_t[N]);
+    SEQAN_OMP_PRAGMA(parallel for schedule(guided, 8))
+    for (size_t v = 0; v < N; ++v) {
+        size_t lower = row_index_t[v + 1] - row_index_t[v];
+        for (size_t i = 0; i < graph[v].size(); ++i) {
+            const auto &edge = graph[v][i];
+            if (i < lower) {
+                col_t[row_index_t[v] + i] = edge.first;
+                dist_t[row_index_t[v] + i] = edge.second;
+            } else {
+                col[row_index[v] + i - lower] = edge.first;
+                dist[row_index[v] + i - lower] = edge.second;
+            }
+        }
+    }
+
+    CrsMatrixPtr direct_matrix(new CrsMatrix(N, std::move(row_index), std::move(col), std::move(dist)));
+    CrsMatrixPtr trans_matrix(new CrsMatrix(N, std::move(row_index_t), std::move(col_t), std::move(dist_t)));
+    return SparseGraphPtr(new SparseGraph(direct_matrix, trans_matrix, std::move(weights)));
+}
+
+
+CsrGraph add_edges(const SparseGraph &base, const CsrGraph &increment) {
+    size_t N = increment.size();
+    VERIFY(base.N() <= N);
+
+    std::vector<size_t> row_index(N + 1, 0);
+    for (size_t v = 0; v < N; ++v) {
+        row_index[v + 1] = row_index[v] + increment[v].size() + (v < base.N() ? base.Degree(v) : 0);
+    }
+
+    std::vector<CsrGraph::Edge> edges(row_index[N]);
+    SEQAN_OMP_PRAGMA(parallel for schedule(guided, 8))
+    for (size_t v = 0; v < N; ++v) {
+        auto out = edges.begin() + row_index[v];
+        if (v < base.N()) {
+            // Transposed part of the row precedes the direct one, both are sorted
+            for (size_t i = base.RowIndexT()[v]; i < base.RowIndexT()[v + 1]; ++i) {
+                *out++ = { base.ColT()[i], static_cast<int>(base.DistT()[i]) };
+            }
+            for (size_t i = base.RowIndex()[v]; i < base.RowIndex()[v + 1]; ++i) {
+                *out++ = { base.Col()[i], static_cast<int>(base.Dist()[i]) };
+            }
+        }
+        auto middle = out;
+        out = std::copy(increment[v].begin(), increment[v].end(), out);
+        std::inplace_merge(edges.begin() + row_index[v], middle, out);
+    }
+
+    return CsrGraph(std::move(row_index), std::move(edges));
+}
+
+
+CsrGraph renumber_vertices(const CsrGraph &graph, const std::vector<size_t> &new_ids, bool renumber_targets) {
+    size_t N = graph.size();
+    VERIFY(new_ids.size() == N);
+
+    std::vector<size_t> row_index(N + 1, 0);
+    for (size_t v = 0; v < N; ++v) {
+        row_index[new_ids[v] + 1] = graph[v].size();
+    }
+    for (size_t v = 0; v < N; ++v) {
+        row_index[v + 1] += row_index[v];
+    }
+
+    std::vector<CsrGraph::Edge> edges(row_index[N]);
+    SEQAN_OMP_PRAGMA(parallel for schedule(guided, 8))
+    for (size_t v = 0; v < N; ++v) {
+        auto out = edges.begin() + row_index[new_ids[v]];
+        for (const auto &edge : graph[v]) {
+            *out++ = { renumber_targets ? new_ids[edge.first] : edge.first, edge.second };
+        }
+        std::sort(edges.begin() + row_index[new_ids[v]], out);
+    }
+
+    return CsrGraph(std::move(row_index), std::move(edges));
+}
+
+
+const char GraphShardHeader::kMagic[8] = { 'I', 'G', 'R', 'S', 'H', 'R', 'D', '\0' };
+
+namespace {
+    struct ShardEntry {
+        uint64_t from;
+        uint64_t to;
+        uint64_t dist;
+    };
+
+    // Sequential buffered reader of shard entries
+    class GraphShardReader {
+    public:
+        explicit GraphShardReader(const std::string &filename) : filename_(filename), in_(filename, std::ios::binary) {
+            VERIFY_MSG(in_.read(reinterpret_cast<char*>(&header_), sizeof(header_)),
+                       "Cannot read graph shard " << filename);
+            VERIFY_MSG(std::equal(header_.magic, header_.magic + sizeof(header_.magic), GraphShardHeader::kMagic),
+                       "File " << filename << " is not a graph shard");
+            VERIFY_MSG(header_.version == GraphShardHeader::kVersion,
+                       "Unsupported version " << header_.version << " of graph shard " << filename);
+            VERIFY_MSG(header_.queries_begin <= header_.queries_end && header_.queries_end <= header_.num_vertices,
+                       "Inconsistent query range in graph shard " << filename);
+        }
+
+        const GraphShardHeader& Header() const { return header_; }
+
+        // Must be called before the first Next()
+        void ReadWeights(std::vector<size_t> &weights) {
+            if (header_.flags & GraphShardHeader::kWeights) {
+                size_t n = header_.queries_end - header_.queries_begin;
+                VERIFY_MSG(in_.read(reinterpret_cast<char*>(weights.data() + header_.queries_begin),
+                                    static_cast<std::streamsize>(n * sizeof(uint64_t))),
+                           "Graph shard " << filename_ << " is truncated");
+            }
+        }
+
+        bool Next(ShardEntry &entry) {
+            if (pos_ == buffer_.size()) {
+                size_t n = std::min<size_t>(kBufferSize, header_.num_entries - consumed_);
+                if (n == 0) {
+                    return false;
+                }
+                buffer_.resize(n);
+                VERIFY_MSG(in_.read(reinterpret_cast<char*>(buffer_.data()),
+                                    static_cast<std::streamsize>(n * sizeof(ShardEntry))),
+                           "Graph shard " << filename_ << " is truncated");
+                consumed_ += n;
+                pos_ = 0;
+            }
+            entry = buffer_[pos_++];
+            return true;
+        }
+
+    private:
+        static const size_t kBufferSize = 1 << 16;
+
+        std::string filename_;
+        std::ifstream in_;
+        GraphShardHeader header_;
+        std::vector<ShardEntry> buffer_;
+        size_t pos_ = 0;
+        size_t consumed_ = 0;
+    };
+}
+
+void write_graph_shard(const std::string &filename,
+                       const CsrGraph &graph,
+                       size_t queries_begin, size_t queries_end,
+                       size_t num_targets,
+                       bool undirected,
+                       const std::vector<size_t> *weights) {
+    static_assert(sizeof(ShardEntry) == 3 * sizeof(uint64_t), "shard entries must be packed");
+
+    GraphShardHeader header;
+    std::copy(GraphShardHeader::kMagic, GraphShardHeader::kMagic + sizeof(header.magic), header.magic);
+    header.version = GraphShardHeader::kVersion;
+    header.flags = (undirected ? GraphShardHeader::kUndirected : 0) | (weights ? GraphShardHeader::kWeights : 0);
+    header.num_vertices = graph.size();
+    header.num_targets = num_targets;
+    header.queries_begin = queries_begin;
+    header.queries_end = queries_end;
+    header.num_entries = graph.Edges().size();
+
+    std::ofstream out(filename, std::ios::binary);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    if (weights) {
+        std::vector<uint64_t> shard_weights(weights->cbegin() + queries_begin, weights->cbegin() + queries_end);
+        out.write(reinterpret_cast<const char*>(shard_weights.data()),
+                  static_cast<std::streamsize>(shard_weights.size() * sizeof(uint64_t)));
+    }
+
+    std::vector<ShardEntry> buffer;
+    for (size_t v = 0; v < graph.size(); ++v) {
+        for (const auto &edge : graph[v]) {
+            buffer.push_back({ v, edge.first, static_cast<uint64_t>(edge.second) });
+        }
+        if (buffer.size() >= (1 << 16) || v + 1 == graph.size()) {
+            out.write(reinterpret_cast<const char*>(buffer.data()),
+                      static_cast<std::streamsize>(buffer.size() * sizeof(ShardEntry)));
+            buffer.clear();
+        }
+    }
+    VERIFY_MSG(out.good(), "Failed to write graph shard " << filename);
+}
+
+CsrGraph merge_graph_shards(const std::vector<std::string> &filenames,
+                            bool &undirected,
+                            std::vector<size_t> &weights) {
+    VERIFY_MSG(!filenames.empty(), "No graph shards to merge");
+
+    std::vector<std::unique_ptr<GraphShardReader>> shards;
+    for (const auto &filename : filenames) {
+        shards.emplace_back(new GraphShardReader(filename));
+    }
+    std::sort(shards.begin(), shards.end(),
+              [](const std::unique_ptr<GraphShardReader> &a, const std::unique_ptr<GraphShardReader> &b) {
+                  return a->Header().queries_begin < b->Header().queries_begin;
+              });
+
+    const GraphShardHeader &first = shards.front()->Header();
+    size_t N = first.num_vertices;
+    size_t num_targets = first.num_targets;
+    undirected = first.flags & GraphShardHeader::kUndirected;
+    bool has_weights = first.flags & GraphShardHeader::kWeights;
+    size_t num_entries = 0;
+    size_t covered = 0;
+    for (size_t i = 0; i < shards.size(); ++i) {
+        const auto &header = shards[i]->Header();
+        VERIFY_MSG(header.num_vertices == N && header.num_targets == num_targets && header.flags == first.flags,
+                   "Graph shards " << filenames.front() << " and " << filenames[i] << " are of different graphs");
+        VERIFY_MSG(header.queries_begin == covered,
+                   "Graph shards do not cover queries [" << covered << ", " << header.queries_begin << ")");
+        covered = header.queries_end;
+        num_entries += header.num_entries;
+    }
+    VERIFY_MSG(covered == N, "Graph shards do not cover queries [" << covered << ", " << N << ")");
+
+    weights.assign(has_weights ? N : 0, 0);
+    if (has_weights) {
+        for (auto &shard : shards) {
+            shard->ReadWeights(weights);
+        }
+    }
+
+    // Heads of shards ordered by (from, to)
+    using Head = std::tuple<uint64_t, uint64_t, uint64_t, size_t>;
+    std::priority_queue<Head, std::vector<Head>, std::greater<Head>> heads;
+    ShardEntry entry;
+    for (size_t i = 0; i < shards.size(); ++i) {
+        if (shards[i]->Next(entry)) {
+            heads.push(Head(entry.from, entry.to, entry.dist, i));
+        }
+    }
+
+    std::vector<size_t> row_index(N + 1, 0);
+    std::vector<CsrGraph::Edge> edges;
+    edges.reserve(num_entries);
+    while (!heads.empty()) {
+        Head head = heads.top();
+        heads.pop();
+        size_t from = std::get<0>(head);
+        size_t shard = std::get<3>(head);
+        VERIFY_MSG(from < N && std::get<1>(head) < num_targets, "Vertex index out of range in graph shard");
+        VERIFY_MSG(edges.empty() || row_index[from + 1] == 0 || edges.back().first < std::get<1>(head),
+                   "Graph shards contain duplicate or unsorted edges");
+        ++row_index[from + 1];
+        edges.push_back({ std::get<1>(head), static_cast<int>(std::get<2>(head)) });
+        if (shards[shard]->Next(entry)) {
+            heads.push(Head(entry.from, entry.to, entry.dist, shard));
+        }
+    }
+    for (size_t v = 0; v < N; ++v) {
+        row_index[v + 1] += row_index[v];
+    }
+
+    return CsrGraph(std::move(row_index), std::move(edges));
+}
+
+// vim: ts=4:sw=4
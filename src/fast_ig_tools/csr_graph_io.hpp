@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "fast_ig_tools.hpp"
+#include "../graph_utils/sparse_graph.hpp"
+
+// Splits rows of symmetric graph into upper (direct) and lower (transposed) triangles of SparseGraph
+SparseGraphPtr to_sparse_graph(const CsrGraph &graph, std::vector<size_t> weights);
+
+
+// Symmetric graph on increment.size() >= base.N() vertices with edges of both base and increment
+CsrGraph add_edges(const SparseGraph &base, const CsrGraph &increment);
+
+
+// Graph with vertex v renamed to new_ids[v]. Targets are renamed as well only if renumber_targets,
+// e.g., rows of a graph against reference reads are permuted, but its columns are not
+CsrGraph renumber_vertices(const CsrGraph &graph, const std::vector<size_t> &new_ids, bool renumber_targets = true);
+
+
+// Partial graph computed by one shard of ig_swgraph_construct, i.e., edges found for queries in
+// [queries_begin, queries_end). Header is followed by abundances of these queries (if kWeights is set)
+// and then by num_entries (from, to, dist) uint64 triples sorted by (from, to), to < num_targets.
+// Undirected shards contain every their edge in both directions, targets of shards against reference
+// are reference reads
+struct GraphShardHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t flags;
+    uint64_t num_vertices;
+    uint64_t num_targets;
+    uint64_t queries_begin;
+    uint64_t queries_end;
+    uint64_t num_entries;
+
+    static const char kMagic[8];
+    static const uint32_t kVersion = 1;
+    static const uint32_t kUndirected = 1;
+    static const uint32_t kWeights = 2;
+};
+
+void write_graph_shard(const std::string &filename,
+                       const CsrGraph &graph,
+                       size_t queries_begin, size_t queries_end,
+                       size_t num_targets,
+                       bool undirected,
+                       const std::vector<size_t> *weights = nullptr);
+
+// k-way merge of shards that cover all queries into the complete graph.
+// weights are filled in only if the shards contain abundances
+CsrGraph merge_graph_shards(const std::vector<std::string> &filenames,
+                            bool &undirected,
+                            std::vector<size_t> &weights);
+
+// vim: ts=4:sw=4
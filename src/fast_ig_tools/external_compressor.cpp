@@ -0,0 +1,228 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <queue>
+#include <utility>
+
+#include <verify.hpp>
+#include <seqan/seq_io.h>
+
+#include "external_compressor.hpp"
+
+namespace fast_ig_tools {
+
+namespace {
+
+// Run file is a sequence of records (uint64 index, uint64 length, length letters)
+// sorted by (sequence, index); a proper prefix precedes its extensions
+class RunReader {
+public:
+    explicit RunReader(const std::string &filename) : in_(filename, std::ios::binary) {
+        VERIFY_MSG(in_, "Cannot open temporary file " << filename);
+    }
+
+    bool Next() {
+        uint64_t header[2];
+        if (!in_.read(reinterpret_cast<char*>(header), sizeof(header))) {
+            return false;
+        }
+        index_ = header[0];
+        read_.resize(header[1]);
+        if (!read_.empty()) {
+            in_.read(&read_[0], static_cast<std::streamsize>(read_.size()));
+        }
+        VERIFY_MSG(in_, "Truncated temporary file");
+        return true;
+    }
+
+    size_t Index() const { return index_; }
+    const std::string &Read() const { return read_; }
+
+private:
+    std::ifstream in_;
+    size_t index_ = 0;
+    std::string read_;
+};
+
+class RunWriter {
+public:
+    explicit RunWriter(const std::string &filename) : out_(filename, std::ios::binary) {
+        VERIFY_MSG(out_, "Cannot create temporary file " << filename);
+    }
+
+    void Write(size_t index, const char *read, size_t length) {
+        uint64_t header[2] = { index, length };
+        out_.write(reinterpret_cast<const char*>(header), sizeof(header));
+        out_.write(read, static_cast<std::streamsize>(length));
+    }
+
+    ~RunWriter() {
+        out_.flush();
+        VERIFY_MSG(out_, "Cannot write temporary file");
+    }
+
+private:
+    std::ofstream out_;
+};
+
+// Chunk of reads kept as concatenated letters
+class Chunk {
+public:
+    void Add(size_t index, const seqan::Dna5String &read) {
+        entries_.push_back({ letters_.size(), seqan::length(read), index });
+        for (size_t i = 0; i < seqan::length(read); ++i) {
+            letters_.push_back(static_cast<char>(read[i]));
+        }
+    }
+
+    size_t Bytes() const {
+        return letters_.size() + entries_.size() * sizeof(Entry);
+    }
+
+    bool Empty() const {
+        return entries_.empty();
+    }
+
+    void Spill(const std::string &filename) {
+        const char *letters = letters_.data();
+        std::sort(entries_.begin(), entries_.end(),
+                  [letters](const Entry &a, const Entry &b) {
+                      int cmp = std::memcmp(letters + a.offset, letters + b.offset, std::min(a.length, b.length));
+                      if (cmp != 0) {
+                          return cmp < 0;
+                      }
+                      return a.length != b.length ? a.length < b.length : a.index < b.index;
+                  });
+
+        RunWriter writer(filename);
+        for (const auto &entry : entries_) {
+            writer.Write(entry.index, letters + entry.offset, entry.length);
+        }
+
+        letters_.clear();
+        entries_.clear();
+    }
+
+private:
+    struct Entry {
+        size_t offset;
+        size_t length;
+        size_t index;
+    };
+
+    std::vector<char> letters_;
+    std::vector<Entry> entries_;
+};
+
+// k-way merge of sorted runs; callback is called for every record in the (sequence, index) order
+void merge_runs(const std::vector<std::string> &filenames,
+                const std::function<void(size_t, const std::string&)> &callback) {
+    std::vector<std::unique_ptr<RunReader>> runs;
+    for (const auto &filename : filenames) {
+        runs.emplace_back(new RunReader(filename));
+    }
+
+    auto greater = [&runs](size_t a, size_t b) {
+        int cmp = runs[a]->Read().compare(runs[b]->Read());
+        return cmp != 0 ? cmp > 0 : runs[a]->Index() > runs[b]->Index();
+    };
+    std::priority_queue<size_t, std::vector<size_t>, decltype(greater)> heads(greater);
+    for (size_t i = 0; i < runs.size(); ++i) {
+        if (runs[i]->Next()) {
+            heads.push(i);
+        }
+    }
+
+    while (!heads.empty()) {
+        size_t run = heads.top();
+        heads.pop();
+        callback(runs[run]->Index(), runs[run]->Read());
+        if (runs[run]->Next()) {
+            heads.push(run);
+        }
+    }
+}
+
+} // namespace
+
+std::vector<size_t> external_compressed_reads_indices(const std::string &input_file,
+                                                      bool ignore_tails,
+                                                      size_t memory_limit,
+                                                      const std::string &tmp_prefix,
+                                                      size_t max_fan_in) {
+    VERIFY(max_fan_in >= 2);
+
+    size_t num_runs = 0;
+    auto run_filename = [&tmp_prefix](size_t run) { return tmp_prefix + ".run" + std::to_string(run); };
+
+    std::vector<std::string> runs;
+    size_t num_reads = 0;
+    {
+        seqan::SeqFileIn input(input_file.c_str());
+        seqan::CharString id;
+        seqan::Dna5String read;
+        Chunk chunk;
+        while (!seqan::atEnd(input)) {
+            seqan::readRecord(id, read, input);
+            chunk.Add(num_reads++, read);
+            if (chunk.Bytes() >= memory_limit) {
+                runs.push_back(run_filename(num_runs++));
+                chunk.Spill(runs.back());
+            }
+        }
+        if (!chunk.Empty()) {
+            runs.push_back(run_filename(num_runs++));
+            chunk.Spill(runs.back());
+        }
+    }
+
+    // Merge runs by groups until one pass is enough
+    while (runs.size() > max_fan_in) {
+        std::vector<std::string> merged;
+        for (size_t begin = 0; begin < runs.size(); begin += max_fan_in) {
+            std::vector<std::string> group(runs.begin() + begin,
+                                           runs.begin() + std::min(begin + max_fan_in, runs.size()));
+            merged.push_back(run_filename(num_runs++));
+            {
+                RunWriter writer(merged.back());
+                merge_runs(group, [&writer](size_t index, const std::string &read) {
+                    writer.Write(index, read.data(), read.size());
+                });
+            }
+            for (const auto &filename : group) {
+                std::remove(filename.c_str());
+            }
+        }
+        runs = std::move(merged);
+    }
+
+    // Every read is joined to the current root while the root is its prefix (equal to it if !ignore_tails);
+    // the root is the shortest such read with the least index, exactly as in TrieCompressor
+    std::vector<size_t> indices(num_reads);
+    std::string root;
+    size_t root_index = 0;
+    bool has_root = false;
+    merge_runs(runs, [&](size_t index, const std::string &read) {
+        bool joined = has_root && (ignore_tails ? read.compare(0, root.size(), root) == 0 : read == root);
+        if (!joined) {
+            root = read;
+            root_index = index;
+            has_root = true;
+        }
+        indices[index] = root_index;
+    });
+
+    for (const auto &filename : runs) {
+        std::remove(filename.c_str());
+    }
+
+    return indices;
+}
+
+} // namespace fast_ig_tools
+
+// vim: ts=4:sw=4
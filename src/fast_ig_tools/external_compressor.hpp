@@ -0,0 +1,22 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace fast_ig_tools {
+
+// Compressor::compressed_reads_indices of the reads of a FASTA|FASTQ file computed in bounded memory,
+// i.e., for TrieCompressor if ignore_tails and for HashCompressor otherwise.
+// Reads are consumed by chunks of about memory_limit bytes; every chunk is sorted by (sequence, length, index)
+// and spilled to a temporary file tmp_prefix + ".runN". Sorted runs are merged (at most max_fan_in at once),
+// so that every read follows the shortest read that is its prefix (or the first read equal to it).
+// Only the result, a word per read, is kept in memory
+std::vector<size_t> external_compressed_reads_indices(const std::string &input_file,
+                                                      bool ignore_tails,
+                                                      size_t memory_limit,
+                                                      const std::string &tmp_prefix,
+                                                      size_t max_fan_in = 256);
+
+} // namespace fast_ig_tools
+
+// vim: ts=4:sw=4
@@ -1,5 +1,10 @@
 #include "fast_ig_tools.hpp"
+#include <algorithm>
+#include <cassert>
+#include <fstream>
 #include <limits>
+#include <openmp_wrapper.h>
+#include <seqan/parallel.h>
 
 size_t numEdges(const Graph &graph,
                 bool undirected) {
@@ -17,31 +22,76 @@ size_t numEdges(const Graph &graph,
 }
 
 
-void write_metis_graph(const Graph &graph,
-                       const std::string &filename,
-                       bool undirected) {
-    std::ofstream out(filename);
+size_t numEdges(const CsrGraph &graph,
+                bool undirected) {
+    size_t nE = graph.Edges().size();
 
-    // Count the numder of vertices and the number of edges
-    size_t nV = graph.size();
-    size_t nE = numEdges(graph, undirected);
+    if (undirected) {
+        nE /= 2;
+    }
 
-    out << nV << " " << nE << " 001\n"; // See http://glaros.dtc.umn.edu/gkhome/fetch/sw/metis/manual.pdf
+    return nE;
+}
 
-    for (const auto &edges : graph) {
-        for (const auto &edge : edges) {
-            out << edge.first + 1 << " " << edge.second << " ";
+
+CsrGraph CsrGraph::FromEdgeBuffers(size_t N, std::vector<std::vector<WeightedEdge>> &buffers, bool symmetric) {
+    // Count degrees
+    std::vector<size_t> row_index(N + 1, 0);
+    SEQAN_OMP_PRAGMA(parallel for schedule(dynamic, 1))
+    for (size_t b = 0; b < buffers.size(); ++b) {
+        for (const auto &e : buffers[b]) {
+            SEQAN_OMP_PRAGMA(atomic)
+            ++row_index[e.from];
+            if (symmetric) {
+                SEQAN_OMP_PRAGMA(atomic)
+                ++row_index[e.to];
+            }
         }
-        out << "\n";
     }
+
+    size_t total = 0;
+    for (size_t &x : row_index) {
+        size_t degree = x;
+        x = total;
+        total += degree;
+    }
+
+    // Scatter edges
+    std::vector<Edge> edges(total);
+    std::vector<size_t> next(row_index.cbegin(), row_index.cend() - 1);
+    SEQAN_OMP_PRAGMA(parallel for schedule(dynamic, 1))
+    for (size_t b = 0; b < buffers.size(); ++b) {
+        for (const auto &e : buffers[b]) {
+            size_t pos;
+            SEQAN_OMP_PRAGMA(atomic capture)
+            pos = next[e.from]++;
+            edges[pos] = { e.to, e.dist };
+            if (symmetric) {
+                SEQAN_OMP_PRAGMA(atomic capture)
+                pos = next[e.to]++;
+                edges[pos] = { e.from, e.dist };
+            }
+        }
+        std::vector<WeightedEdge>().swap(buffers[b]);
+    }
+    next.clear();
+    next.shrink_to_fit();
+
+    SEQAN_OMP_PRAGMA(parallel for schedule(guided, 8))
+    for (size_t v = 0; v < N; ++v) {
+        std::sort(edges.begin() + row_index[v], edges.begin() + row_index[v + 1]);
+    }
+
+    return CsrGraph(std::move(row_index), std::move(edges));
 }
 
 
-void write_metis_graph(const Graph &graph,
-                       const std::vector<size_t> &weights,
-                       const std::string &filename,
-                       bool undirected) {
-    assert(graph.size() == weights.size());
+template<typename TGraph>
+void write_metis_graph_impl(const TGraph &graph,
+                            const std::vector<size_t> *weights,
+                            const std::string &filename,
+                            bool undirected) {
+    assert(!weights || graph.size() == weights->size());
 
     std::ofstream out(filename);
 
@@ -49,10 +99,12 @@ void write_metis_graph(const Graph &graph,
     size_t nV = graph.size();
     size_t nE = numEdges(graph, undirected);
 
-    out << nV << " " << nE << " 011\n"; // See http://glaros.dtc.umn.edu/gkhome/fetch/sw/metis/manual.pdf
+    out << nV << " " << nE << (weights ? " 011\n" : " 001\n"); // See http://glaros.dtc.umn.edu/gkhome/fetch/sw/metis/manual.pdf
 
     for (size_t i = 0; i < graph.size(); ++i) {
-        out << weights[i] << " ";
+        if (weights) {
+            out << (*weights)[i] << " ";
+        }
         for (const auto &edge : graph[i]) {
             out << edge.first + 1 << " " << edge.second << " ";
         }
@@ -60,6 +112,36 @@ void write_metis_graph(const Graph &graph,
     }
 }
 
+
+void write_metis_graph(const Graph &graph,
+                       const std::string &filename,
+                       bool undirected) {
+    write_metis_graph_impl(graph, nullptr, filename, undirected);
+}
+
+
+void write_metis_graph(const Graph &graph,
+                       const std::vector<size_t> &weights,
+                       const std::string &filename,
+                       bool undirected) {
+    write_metis_graph_impl(graph, &weights, filename, undirected);
+}
+
+
+void write_metis_graph(const CsrGraph &graph,
+                       const std::string &filename,
+                       bool undirected) {
+    write_metis_graph_impl(graph, nullptr, filename, undirected);
+}
+
+
+void write_metis_graph(const CsrGraph &graph,
+                       const std::vector<size_t> &weights,
+                       const std::string &filename,
+                       bool undirected) {
+    write_metis_graph_impl(graph, &weights, filename, undirected);
+}
+
 bool check_repr_kmers_consistancy(const std::vector<size_t> &answer,
                                   const std::vector<size_t> &multiplicities,
                                   size_t K, size_t n) {
@@ -84,44 +166,49 @@ bool check_repr_kmers_consistancy(const std::vector<size_t> &answer,
 // TODO cover by tests
 // and then, refactor it!!!!!!!!111111111111oneoneone
 // TODO Rename it to be consistent with the paper
-std::vector<size_t> optimal_coverage(const std::vector<size_t> &multiplicities,
-                                     size_t K, size_t n) {
+void optimal_coverage(const std::vector<size_t> &multiplicities,
+                      size_t K, size_t n,
+                      std::vector<size_t> &result,
+                      std::vector<size_t> &workspace) {
     assert(n >= 1);
     assert(multiplicities.size() + K - 1 >= n * K);
 
     const size_t INF = std::numeric_limits<size_t>::max() / 2;
 
-    std::vector<std::vector<size_t>> mults(n, std::vector<size_t>(multiplicities.size()));
+    // mults(j, i) is stored in workspace[j * m + i]
+    const size_t m = multiplicities.size();
+    workspace.resize(n * m);
+    auto mults = [&workspace, m](size_t j, size_t i) -> size_t& { return workspace[j * m + i]; };
 
     // Fill by cummin
-    mults[0][0] = multiplicities[0];
-    for (size_t i = 1; i < mults[0].size(); ++i) {
-        mults[0][i] = std::min(multiplicities[i], mults[0][i - 1]);
+    mults(0, 0) = multiplicities[0];
+    for (size_t i = 1; i < m; ++i) {
+        mults(0, i) = std::min(multiplicities[i], mults(0, i - 1));
     }
 
     for (size_t j = 1; j < n; ++j) { // n == 1 is useless
         // Kill first K*j elements
         for (size_t i = 0; i < K*j; ++i) {
-            mults[j][i] = INF;
+            mults(j, i) = INF;
         }
 
-        for (size_t i = K*j; i < mults[j].size(); ++i) {
-            mults[j][i] = std::min(mults[j][i - 1],
-                                   multiplicities[i] + mults[j - 1][i - K]);
+        for (size_t i = K*j; i < m; ++i) {
+            mults(j, i) = std::min(mults(j, i - 1),
+                                   multiplicities[i] + mults(j - 1, i - K));
         }
     }
 
-    auto ans = mults[n - 1][mults[n - 1].size() - 1];
+    auto ans = mults(n - 1, m - 1);
 
     VERIFY(ans < INF);
 
-    std::vector<size_t> result(n);
+    result.resize(n);
     // Backward reconstruction
-    size_t i = mults[n - 1].size() - 1;
+    size_t i = m - 1;
     size_t j = n - 1;
 
     while (j > 0) {
-        if (mults[j][i] == multiplicities[i] + mults[j - 1][i - K]) { // Take i-th element
+        if (mults(j, i) == multiplicities[i] + mults(j - 1, i - K)) { // Take i-th element
             result[j] = i;
             i -= K;
             j -= 1;
@@ -132,7 +219,7 @@ std::vector<size_t> optimal_coverage(const std::vector<size_t> &multiplicities,
     assert(j == 0);
     // Find first element
     size_t ii = i;
-    while (mults[0][i] != multiplicities[ii]) {
+    while (mults(0, i) != multiplicities[ii]) {
         --ii;
     }
     result[0] = ii;
@@ -146,7 +233,13 @@ std::vector<size_t> optimal_coverage(const std::vector<size_t> &multiplicities,
     assert(ans == sum);
 
     assert(check_repr_kmers_consistancy(result, multiplicities, K, n));
+}
 
+std::vector<size_t> optimal_coverage(const std::vector<size_t> &multiplicities,
+                                     size_t K, size_t n) {
+    std::vector<size_t> result;
+    std::vector<size_t> workspace;
+    optimal_coverage(multiplicities, K, n, result, workspace);
     return result;
 }
 
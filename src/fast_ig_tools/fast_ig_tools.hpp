@@ -1,6 +1,8 @@
 #pragma once
 
 #include <string>
+#include <vector>
+#include <utility>
 #include <path_helper.hpp>
 #include <perfcounter.hpp>
 
@@ -13,9 +15,71 @@ using bformat = boost::format;
 
 using Graph = std::vector<std::vector<std::pair<size_t, int>>>;
 
+struct WeightedEdge {
+    size_t from;
+    size_t to;
+    int dist;
+};
+
+// Graph in compressed sparse rows format: adjacency list of vertex v is Edges()[RowIndex()[v], RowIndex()[v + 1]),
+// sorted by target vertex. Rows can be accessed in the same way as those of Graph
+class CsrGraph {
+public:
+    using Edge = std::pair<size_t, int>;
+
+    class Row {
+    public:
+        Row(const Edge *begin, const Edge *end) : begin_(begin), end_(end) { }
+
+        const Edge* begin() const { return begin_; }
+
+        const Edge* end() const { return end_; }
+
+        size_t size() const { return static_cast<size_t>(end_ - begin_); }
+
+        bool empty() const { return begin_ == end_; }
+
+        const Edge& operator[](size_t i) const { return begin_[i]; }
+
+    private:
+        const Edge *begin_;
+        const Edge *end_;
+    };
+
+    CsrGraph() : row_index_(1, 0) { }
+
+    CsrGraph(std::vector<size_t> row_index, std::vector<Edge> edges) :
+            row_index_(std::move(row_index)), edges_(std::move(edges)) { }
+
+    // Assembles graph on N vertices from directed edges collected, e.g., by different threads.
+    // If symmetric, every edge is stored in both directions. Buffers are released as soon as they are consumed
+    static CsrGraph FromEdgeBuffers(size_t N, std::vector<std::vector<WeightedEdge>> &buffers, bool symmetric);
+
+    size_t size() const { return row_index_.size() - 1; }
+
+    Row operator[](size_t v) const {
+        return Row(edges_.data() + row_index_[v], edges_.data() + row_index_[v + 1]);
+    }
+
+    const std::vector<size_t>& RowIndex() const { return row_index_; }
+
+    const std::vector<Edge>& Edges() const { return edges_; }
+
+    bool operator==(const CsrGraph &other) const {
+        return row_index_ == other.row_index_ && edges_ == other.edges_;
+    }
+
+private:
+    std::vector<size_t> row_index_;
+    std::vector<Edge> edges_;
+};
+
 size_t numEdges(const Graph &graph,
                 bool undirected = true);
 
+size_t numEdges(const CsrGraph &graph,
+                bool undirected = true);
+
 void write_metis_graph(const Graph &graph,
                        const std::string &filename,
                        bool undirected = true);
@@ -25,7 +89,23 @@ void write_metis_graph(const Graph &graph,
                        const std::string &filename,
                        bool undirected = true);
 
+void write_metis_graph(const CsrGraph &graph,
+                       const std::string &filename,
+                       bool undirected = true);
+
+void write_metis_graph(const CsrGraph &graph,
+                       const std::vector<size_t> &weights,
+                       const std::string &filename,
+                       bool undirected = true);
+
 std::vector<size_t> optimal_coverage(const std::vector<size_t> &multiplicities,
                                      size_t K, size_t n = 3);
 
+// The same as above, but writes the answer into result and reuses workspace, so it does not allocate
+// once the buffers have grown to their working size
+void optimal_coverage(const std::vector<size_t> &multiplicities,
+                      size_t K, size_t n,
+                      std::vector<size_t> &result,
+                      std::vector<size_t> &workspace);
+
 // vim: ts=4:sw=4
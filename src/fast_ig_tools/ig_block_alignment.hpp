@@ -482,9 +482,8 @@ public:
             this->queries = queries;
 
             for (size_t j = 0; j < this->queries.size(); ++j) {
-                auto hashes = polyhashes(queries[j], K);
-                for (size_t start = 0; start + K <= length(queries[j]); ++start) {
-                    kmer2needle[hashes[start]].push_back( { j, start } );
+                for (const auto &kmer : algorithms::kmer_hashes(queries[j], K, algorithms::NPolicy::Skip)) {
+                    kmer2needle[kmer.hash].push_back( { j, kmer.position } );
                 }
             }
         }
@@ -585,10 +584,13 @@ private:
             return {  };
         }
 
-        auto hashes = polyhashes(read, K);
-        for (size_t j = start; j < finish - K + 1; ++j) { // Scan k-mers on given interval
-            auto kmer = hashes[j];
-            auto it = kmer2needle.find(kmer);
+        for (const auto &kmer : algorithms::kmer_hashes(read, K, algorithms::NPolicy::Skip)) {
+            // Scan k-mers on given interval
+            if (kmer.position < start) continue;
+            if (kmer.position + K > finish) break;
+
+            size_t j = kmer.position;
+            auto it = kmer2needle.find(kmer.hash);
 
             if (it == kmer2needle.cend()) {
                 continue;
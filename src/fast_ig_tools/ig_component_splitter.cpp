@@ -1,5 +1,7 @@
 #include <cassert>
 #include <algorithm>
+#include <array>
+#include <numeric>
 
 #include <unordered_map>
 #include <build_info.hpp>
@@ -14,6 +16,7 @@ namespace po = boost::program_options;
 #include <boost/algorithm/string.hpp>
 
 #include "fast_ig_tools.hpp"
+#include "column_profile.hpp"
 #include "ig_final_alignment.hpp"
 #include "ig_matcher.hpp"
 #include "utils.hpp"
@@ -53,11 +56,13 @@ std::unordered_map<std::string, std::string> read_rcm_file(const std::string &fi
 template<typename T = seqan::Dna5>
 void split_component(const std::vector<seqan::String<T>> &reads,
                      const std::vector<size_t> &indices,
+                     ColumnProfile<T> profile,
                      std::vector<std::pair<seqan::String<T>, std::vector<size_t>>> &out,
                      size_t max_votes = 1,
                      bool discard = false,
                      bool recursive = true,
-                     bool flu = true) {
+                     bool flu = true,
+                     std::vector<std::pair<size_t, size_t>> *splits = nullptr) {
     if (!max_votes) {
         max_votes = std::numeric_limits<size_t>::max() / 2;
     }
@@ -71,23 +76,7 @@ void split_component(const std::vector<seqan::String<T>> &reads,
         return;
     }
 
-    using namespace seqan;
-
-    String<ProfileChar<T>> profile;
-
-    size_t len = 0;
-    for (size_t i : indices) {
-        len = std::max(len, length(reads[i]));
-    }
-
-    resize(profile, len);
-
-    for (size_t i : indices) {
-        const auto &read = reads[i];
-        for (size_t j = 0; j < length(read); ++j) {
-            profile[j].count[ordValue(read[j])] += 1;
-        }
-    }
+    VERIFY(profile.size() == indices.size());
 
     // Find secondary votes
     struct PositionVote {
@@ -96,30 +85,24 @@ void split_component(const std::vector<seqan::String<T>> &reads,
         size_t secondary_votes;
         size_t secondary_letter;
         size_t position;
-        bool operator<(const PositionVote &b) const {
-            return secondary_votes < b.secondary_votes;
-        }
     };
 
-    // INFO("Splitting component size=" << indices.size() << " len=" << len);
-    size_t min_len = length(reads[indices[0]]);
-    for (size_t i : indices) {
-        min_len = std::min(min_len, length(reads[i]));
-    }
-
-    std::vector<PositionVote> secondary_votes;
+    // INFO("Splitting component size=" << indices.size() << " len=" << profile.length());
+    // The first position of maximal secondary votes
+    size_t min_len = profile.min_length();
+    PositionVote maximal_mismatch = { 0, 0, 0, 0, 0 };
     for (size_t j = 0; j < min_len; ++j) {
-        std::vector<std::pair<size_t, size_t>> v;
+        std::array<std::pair<size_t, size_t>, 4> v;
         for (size_t k = 0; k < 4; ++k) {
-            v.push_back({ profile[j].count[k], k });
+            v[k] = { profile.count(j, k), k };
         }
 
-        // Use nth element here???
         std::sort(v.rbegin(), v.rend());
-        secondary_votes.push_back({ v[0].first, v[0].second, v[1].first, v[1].second, j });
+        if (j == 0 || v[1].first > maximal_mismatch.secondary_votes) {
+            maximal_mismatch = { v[0].first, v[0].second, v[1].first, v[1].second, j };
+        }
     }
 
-    auto maximal_mismatch = *std::max_element(secondary_votes.cbegin(), secondary_votes.cend());
     VERIFY(maximal_mismatch.majory_votes >= maximal_mismatch.secondary_votes);
 
     TRACE("VOTES: " << maximal_mismatch.majory_votes << "/" << maximal_mismatch.secondary_votes << " POSITION: " << maximal_mismatch.position);
@@ -131,7 +114,7 @@ void split_component(const std::vector<seqan::String<T>> &reads,
     } else {
         do_split = mmsv >= max_votes;
     }
-    if (indices.size() <= 5) {
+    if (indices.size() <= 5 || min_len == 0) {
         do_split = false;
     }
 
@@ -140,15 +123,7 @@ void split_component(const std::vector<seqan::String<T>> &reads,
     }
 
     if (! do_split) {
-        seqan::String<T> consensus;
-        for (size_t i = 0; i < length(profile); ++i) {
-            size_t idx = getMaxIndex(profile[i]);
-            if (idx < ValueSize<T>::VALUE) {  // is not gap  TODO Check it!!
-                appendValue(consensus, T(getMaxIndex(profile[i])));
-            }
-        }
-
-        out.push_back({ consensus, indices });
+        out.push_back({ profile.consensus(), indices });
         return;
     }
 
@@ -166,30 +141,55 @@ void split_component(const std::vector<seqan::String<T>> &reads,
     VERIFY(indices_majory.size() == maximal_mismatch.majory_votes);
     VERIFY(indices_secondary.size() == maximal_mismatch.secondary_votes);
 
-    auto majory_consensus = consensus_hamming(reads, indices_majory);
-    auto secondary_consensus = consensus_hamming(reads, indices_secondary);
+    // Parts get the profile of the cluster minus the profiles of the other parts,
+    // so that only the smaller parts are counted read by read
+    ColumnProfile<T> profile_other(reads, indices_other);
+    ColumnProfile<T> profile_majory, profile_secondary;
+    profile.subtract(profile_other);
+    if (indices_majory.size() < indices_secondary.size()) {
+        profile_majory.add(reads, indices_majory);
+        profile.subtract(profile_majory);
+        profile_secondary = std::move(profile);
+    } else {
+        profile_secondary.add(reads, indices_secondary);
+        profile.subtract(profile_secondary);
+        profile_majory = std::move(profile);
+    }
+
+    auto majory_consensus = profile_majory.consensus();
+    auto secondary_consensus = profile_secondary.consensus();
 
+    std::vector<size_t> other_majory, other_secondary;
     for (size_t i : indices_other) {
         auto dist_majory = hamming_rtrim(reads[i], majory_consensus);
         auto dist_secondary = hamming_rtrim(reads[i], secondary_consensus);
 
         if (dist_majory <= dist_secondary) {
             indices_majory.push_back(i);
+            other_majory.push_back(i);
         } else {
             indices_secondary.push_back(i);
+            other_secondary.push_back(i);
         }
     }
+    profile_majory.add(reads, other_majory);
+    profile_secondary.add(reads, other_secondary);
 
     VERIFY(indices_majory.size() + indices_secondary.size() == indices.size());
     VERIFY(indices_majory.size() <= indices.size());
 
-    INFO("Component splitted " << indices_majory.size() << " + " << indices_secondary.size());
+    // Sizes of parts are collected for logging by the caller if components are split in parallel
+    if (splits) {
+        splits->push_back({ indices_majory.size(), indices_secondary.size() });
+    } else {
+        INFO("Component splitted " << indices_majory.size() << " + " << indices_secondary.size());
+    }
 
     if (!recursive) {
         max_votes = 0;
     }
 
-    split_component(reads, indices_majory, out, max_votes, discard, flu);
+    split_component(reads, indices_majory, std::move(profile_majory), out, max_votes, discard, flu, true, splits);
 
     if (discard) {
         for (size_t index : indices_secondary) {
@@ -197,24 +197,40 @@ void split_component(const std::vector<seqan::String<T>> &reads,
         }
     } else {
         VERIFY(indices_secondary.size() < indices.size());
-        split_component(reads, indices_secondary, out, max_votes, discard, flu);
+        split_component(reads, indices_secondary, std::move(profile_secondary), out, max_votes, discard, flu, true,
+                        splits);
     }
 }
 
 
+template<typename T = seqan::Dna5>
+void split_component(const std::vector<seqan::String<T>> &reads,
+                     const std::vector<size_t> &indices,
+                     std::vector<std::pair<seqan::String<T>, std::vector<size_t>>> &out,
+                     size_t max_votes = 1,
+                     bool discard = false,
+                     bool recursive = true,
+                     bool flu = true,
+                     std::vector<std::pair<size_t, size_t>> *splits = nullptr) {
+    split_component(reads, indices, ColumnProfile<T>(reads, indices), out, max_votes, discard, recursive, flu,
+                    splits);
+}
+
+
 template<typename T = seqan::Dna5>
 std::vector<std::pair<seqan::String<T>, std::vector<size_t>>> split_component(const std::vector<seqan::String<T>> &reads,
                                                                               const std::vector<size_t> &indices,
                                                                               size_t max_votes = 0,
                                                                               bool discard = false,
                                                                               bool recursive = true,
-                                                                              bool flu = true) {
+                                                                              bool flu = true,
+                                                                              std::vector<std::pair<size_t, size_t>> *splits = nullptr) {
     if (!max_votes) {
         max_votes = std::numeric_limits<size_t>::max() / 2;
     }
 
     std::vector<std::pair<seqan::String<T>, std::vector<size_t>>> result;
-    split_component(reads, indices, result, max_votes, discard, recursive, flu);
+    split_component(reads, indices, result, max_votes, discard, recursive, flu, splits);
 
     return result;
 }
@@ -390,7 +406,6 @@ int main(int argc, char **argv) {
 
     omp_set_num_threads(nthreads);
     INFO(bformat("Computation of consensus using %d threads starts") % nthreads);
-    INFO("Saving results");
 
     SeqFileOut seqFileOut_output(output_file.c_str());
 
@@ -400,11 +415,35 @@ int main(int argc, char **argv) {
     std::vector<std::pair<std::string, std::vector<size_t>>> comp2readnum_sorted(comp2readnum.cbegin(), comp2readnum.cend());
     std::sort(comp2readnum_sorted.begin(), comp2readnum_sorted.end());
 
-    // TODO Use multithreading
-    for (const auto &kv : comp2readnum_sorted) {
-        const auto &comp = kv.first;
-        const auto &indices = kv.second;
-        auto result = split_component(input_reads, indices, max_votes, discard, recursive, flu);
+    // Clusters are split in parallel, the largest ones first, so that they do not finish the loop alone.
+    // Results are kept and written in the sorted order of clusters
+    std::vector<size_t> order(comp2readnum_sorted.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(),
+                     [&comp2readnum_sorted](size_t c1, size_t c2) -> bool {
+                         return comp2readnum_sorted[c1].second.size() > comp2readnum_sorted[c2].second.size();
+                     });
+
+    std::vector<std::vector<std::pair<Dna5String, std::vector<size_t>>>> results(comp2readnum_sorted.size());
+    std::vector<std::vector<std::pair<size_t, size_t>>> splits(comp2readnum_sorted.size());
+    SEQAN_OMP_PRAGMA(parallel for schedule(dynamic))
+    for (size_t j = 0; j < order.size(); ++j) {
+        size_t c = order[j];
+        results[c] = split_component(input_reads, comp2readnum_sorted[c].second, max_votes, discard, recursive, flu,
+                                     &splits[c]);
+    }
+
+    // Splits are logged in the same order as clusters are written
+    for (const auto &cluster_splits : splits) {
+        for (const auto &split : cluster_splits) {
+            INFO("Component splitted " << split.first << " + " << split.second);
+        }
+    }
+
+    INFO("Saving results");
+    for (size_t c = 0; c < comp2readnum_sorted.size(); ++c) {
+        const auto &comp = comp2readnum_sorted[c].first;
+        auto result = std::move(results[c]);
         for (size_t i = 0; i < result.size(); ++i) {
             std::stringstream ss(comp);
             if (result.size() > 1) {
@@ -8,6 +8,8 @@
 #include <seqan/align.h>
 #include <seqan/graph_msa.h>
 
+#include "column_profile.hpp"
+
 
 template<typename T = seqan::Dna5>
 seqan::String<T> consensus(const std::vector<seqan::String<T>> &reads,
@@ -53,35 +55,7 @@ seqan::String<T> consensus(const std::vector<seqan::String<T>> &reads) {
 template<typename T = seqan::Dna5>
 seqan::String<T> consensus_hamming(const std::vector<seqan::String<T>> &reads,
                                    const std::vector<size_t> &indices) {
-    using namespace seqan;
-    using _String = seqan::String<T>;
-
-    String<ProfileChar<T>> profile;
-
-    size_t len = 0;
-    for (size_t i : indices) {
-        len = std::max(len, length(reads[i]));
-    }
-
-    resize(profile, len);
-
-    for (size_t i : indices) {
-        const auto &read = reads[i];
-        for (size_t j = 0; j < length(read); ++j) {
-            profile[j].count[ordValue(read[j])] += 1;
-        }
-    }
-
-    // call consensus from this string
-    _String consensus;
-    for (size_t i = 0; i < length(profile); ++i) {
-        size_t idx = getMaxIndex(profile[i]);
-        if (idx < ValueSize<T>::VALUE) {  // is not gap  TODO Check it!!
-            appendValue(consensus, T(getMaxIndex(profile[i])));
-        }
-    }
-
-    return consensus;
+    return ColumnProfile<T>(reads, indices).consensus();
 }
 
 
@@ -90,43 +64,10 @@ seqan::String<T> consensus_hamming_limited_coverage(const std::vector<seqan::Str
                                                     const std::vector<size_t> &indices,
                                                     const std::vector<size_t> &abundances,
                                                     size_t coverage_limit = 5) {
-    using namespace seqan;
-    using std::vector;
-    using std::max;
-    using std::min;
-    using _String = seqan::String<T>;
-
-    // Compute result length
-    size_t len = 0;
-    for (size_t i : indices) {
-        len = max(len, length(reads[i]));
-    }
-
-    String<ProfileChar<T>> profile;
-    resize(profile, len);
-    vector<size_t> coverage(len);
-
-    for (size_t i : indices) {
-        const auto &read = reads[i];
-        for (size_t j = 0; j < length(read); ++j) {
-            profile[j].count[ordValue(read[j])] += abundances[i];
-            coverage[j] += abundances[i];
-        }
-    }
+    ColumnProfile<T> profile(reads, indices, abundances);
+    coverage_limit = std::min(coverage_limit, profile.coverage(0));
 
-    coverage_limit = min(coverage_limit, coverage[0]);
-
-    _String consensus;
-    for (size_t i = 0; i < len; ++i) {
-        if (coverage[i] < coverage_limit) break;
-
-        size_t idx = getMaxIndex(profile[i]);
-        if (idx < ValueSize<T>::VALUE) {  // is not gap  TODO Check it!!
-            appendValue(consensus, T(idx));
-        }
-    }
-
-    return consensus;
+    return profile.consensus(profile.covered_length(coverage_limit));
 }
 
 
@@ -138,8 +79,9 @@ seqan::String<T> consensus_hamming(const std::vector<seqan::String<T>> &reads) {
 }
 
 
-template<typename T>
-std::vector<size_t> find_abundances(const std::vector<T> &ids) {
+// TIds is a random-access collection of identifiers, e.g., std::vector<CharString> or PackedReadStore::Ids
+template<typename TIds>
+std::vector<size_t> find_abundances(const TIds &ids) {
     std::vector<size_t> result(ids.size());
     const std::string pat = "___size___";
 
@@ -13,6 +13,7 @@ using std::endl;
 #include "fast_ig_tools.hpp"
 #include "ig_final_alignment.hpp"
 #include "ig_matcher.hpp"
+#include "packed_reads.hpp"
 #include "banded_half_smith_waterman.hpp"
 #include "utils.hpp"
 
@@ -33,15 +34,11 @@ std::pair<size_t, std::vector<size_t>> find_candidates_num(const T &read,
 
     std::vector<size_t> costs;
 
-    auto hashes = polyhashes(read, K);
+    auto hashes = algorithms::kmer_hashes(read, K);
 
-    costs.reserve(hashes.size());
-    for (size_t hash : hashes) {
-        auto it = kmer2reads.find(hash);
-        if (it != kmer2reads.cend()) // TODO check it
-            costs.push_back(it->second.size());
-        else
-            costs.push_back(0);
+    costs.reserve(hashes.NumWindows());
+    for (const auto &kmer : hashes) {
+        costs.push_back(kmer2reads.find(kmer.hash).size());
     }
 
     std::vector<size_t> ind = optimal_coverage(costs, K, tau + 1);
@@ -49,18 +46,14 @@ std::pair<size_t, std::vector<size_t>> find_candidates_num(const T &read,
     size_t result = 0;
 
     for (size_t i : ind) {
-        size_t hash = hashes[i];
-        auto it = kmer2reads.find(hash);
-        if (it != kmer2reads.cend()) {
-            result += it->second.size();
-        }
+        result += costs[i];
     }
 
     return { result, ind };
 }
 
-template<typename T>
-size_t complexityEstimation(const std::vector<T> &input_reads,
+template<typename TReads>
+size_t complexityEstimation(const TReads &input_reads,
                             const KmerIndex &kmer2reads,
                             int tau,
                             int K,
@@ -203,17 +196,13 @@ int main(int argc, char **argv) {
 
     INFO("Input reads: " << input_file);
 
-    SeqFileIn seqFileIn_input(input_file.c_str());
-    std::vector<CharString> input_ids;
-    std::vector<Dna5String> input_reads;
-
     INFO("Reading input reads starts");
-    readRecords(input_ids, input_reads, seqFileIn_input);
+    auto input_reads = PackedReadStore::read_file(input_file);
     INFO(input_reads.size() << " reads were extracted from " << input_file);
 
     size_t min_L = 999999999;
-    for (const auto &read : input_reads) {
-        min_L = std::min(min_L, length(read));
+    for (size_t j = 0; j < input_reads.size(); ++j) {
+        min_L = std::min(min_L, input_reads[j].length());
     }
 
     INFO("Minimal length: " << min_L);
@@ -228,12 +217,12 @@ int main(int argc, char **argv) {
     out << "# tau: " << tau << std::endl;
     out << "k\td_count\tav_d_count" << std::endl;
 
+    omp_set_num_threads(nthreads);
+
     for (int K = 5; K <= std::max(static_cast<int>(min_L) / (tau + 1), 100); K += k_step) {
         INFO("K-mer index construction. K = " << K);
         auto kmer2reads = kmerIndexConstruction(input_reads, K);
 
-        omp_set_num_threads(nthreads);
-
         std::vector<std::vector<size_t>> opt_kmers(input_reads.size());
 
         INFO(bformat("Complexity estimation using %d threads starts") % nthreads);
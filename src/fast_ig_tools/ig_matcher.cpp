@@ -1,8 +1,5 @@
 #include <chrono>
 
-#include <future>
-using std::async;
-
 #include <boost/program_options.hpp>
 namespace po = boost::program_options;
 
@@ -22,6 +19,8 @@ using seqan::CharString;
 #include <openmp_wrapper.h>
 
 #include "ig_matcher.hpp"
+#include "packed_reads.hpp"
+#include "reference_index.hpp"
 #include "banded_half_smith_waterman.hpp"
 #include "utils.hpp"
 
@@ -80,9 +79,9 @@ void write_best_hits(const std::vector<BestScoreIndices> &g, const std::string &
 }
 
 
-template<typename T, typename Tf>
-void bestScorePairing(const std::vector<T> &input_reads1,
-                      const std::vector<T> &input_reads2,
+template<typename TReads1, typename TReads2, typename Tf>
+void bestScorePairing(const TReads1 &input_reads1,
+                      const TReads2 &input_reads2,
                       const KmerIndex &kmer2reads1,
                       const KmerIndex &kmer2reads2,
                       const Tf &score_fun,
@@ -94,9 +93,14 @@ void bestScorePairing(const std::vector<T> &input_reads1,
     std::vector<BestScoreIndices> g1(input_reads1.size());
     std::vector<BestScoreIndices> g2(input_reads2.size());
 
-    SEQAN_OMP_PRAGMA(parallel for schedule(dynamic, 8))
+    SEQAN_OMP_PRAGMA(parallel)
+    {
+        CandidateScratch scratch;
+
+        SEQAN_OMP_PRAGMA(for schedule(dynamic, 8))
         for (size_t j = 0; j < input_reads1.size(); ++j) {
-            auto cand = find_candidates(input_reads1[j], kmer2reads2, input_reads2.size(), tau, K, strategy);
+            const auto &cand = find_candidates(input_reads1[j], kmer2reads2, input_reads2.size(), tau, K, strategy,
+                                               scratch);
 
             for (size_t i : cand) {
                 int score = score_fun(input_reads1[j], input_reads2[i]);
@@ -105,9 +109,10 @@ void bestScorePairing(const std::vector<T> &input_reads1,
             }
         }
 
-    SEQAN_OMP_PRAGMA(parallel for schedule(dynamic, 8))
+        SEQAN_OMP_PRAGMA(for schedule(dynamic, 8))
         for (size_t j = 0; j < input_reads2.size(); ++j) {
-            auto cand = find_candidates(input_reads2[j], kmer2reads1, input_reads1.size(), tau, K, strategy);
+            const auto &cand = find_candidates(input_reads2[j], kmer2reads1, input_reads1.size(), tau, K, strategy,
+                                               scratch);
 
             for (size_t i : cand) {
                 int score = score_fun(input_reads2[j], input_reads1[i]);
@@ -115,6 +120,7 @@ void bestScorePairing(const std::vector<T> &input_reads1,
                 g1[i].update(score, j); // With lock !!!
             }
         }
+    }
 
     SEQAN_OMP_PRAGMA(parallel for schedule(guided, 8))
         for (size_t i = 0; i < g1.size(); ++i) {
@@ -142,6 +148,7 @@ int main(int argc, char **argv) {
     std::string input_file2 = "input2.fa";
     std::string output_file1 = "output1.match";
     std::string output_file2 = "output2.match";
+    std::string reference_index_file = "";
     unsigned strategy = 3;
 
     // Parse cmd-line arguments
@@ -160,6 +167,9 @@ int main(int argc, char **argv) {
              "name of the first input file (FASTA|FASTQ)")
             ("input-file2,I", po::value<std::string>(&input_file2),
              "name of the second input file (FASTA|FASTQ)")
+            ("reference-index", po::value<std::string>(&reference_index_file),
+             "second input reads with their k-mer index written by 'ig_swgraph_construct build-index'; "
+             "if the second input file is given too, the index is checked to be built from it")
             ("output-file1,o", po::value<std::string>(&output_file1)->default_value(output_file1),
              "file for output match for reads of the first file to reads of the second one")
             ("output-file2,O", po::value<std::string>(&output_file2)->default_value(output_file2),
@@ -222,7 +232,7 @@ int main(int argc, char **argv) {
             return 0;
         }
 
-        if (vm.count("help") || !vm.count("input-file1") || !vm.count("input-file2")) { // TODO Process required arguments by the proper way
+        if (vm.count("help") || !vm.count("input-file1") || (!vm.count("input-file2") && !vm.count("reference-index"))) { // TODO Process required arguments by the proper way
             cout << visible << "\n";
             return 0;
         }
@@ -232,8 +242,12 @@ int main(int argc, char **argv) {
             return 0;
         }
 
+        if (!vm.count("input-file2")) {
+            input_file2 = "";
+        }
+
         cout << "Input files are: "
-            << vm["input-file1"].as<std::string>() << ", "<< vm["input-file2"].as<std::string>() << "\n";
+            << input_file1 << ", " << (reference_index_file != "" ? reference_index_file : input_file2) << "\n";
 
         cout << "K = " << K << endl;
         cout << "tau = " << tau << endl;
@@ -242,43 +256,46 @@ int main(int argc, char **argv) {
         return 1;
     }
 
-    SeqFileIn seqFileIn_input1(input_file1.c_str());
-    SeqFileIn seqFileIn_input2(input_file2.c_str());
-    std::vector<CharString> input_ids1, input_ids2; // Really, they are useless =)
-    std::vector<Dna5String> input_reads1, input_reads2;
-
     cout << "Reading data..." << std::endl;
-    readRecords(input_ids1, input_reads1, seqFileIn_input1);
-    readRecords(input_ids2, input_reads2, seqFileIn_input2);
-    cout << bformat("Reads: %d\n") % length(input_reads1);
-    cout << bformat("Reads: %d\n") % length(input_reads2);
+    auto input_reads1 = PackedReadStore::read_file(input_file1);
+    cout << bformat("Reads: %d\n") % input_reads1.size();
+
+    omp_set_num_threads(nthreads);
+
+    // The second input goes through the same packed representation whether it is read or loaded
+    ReferenceIndex input2;
+    if (reference_index_file != "") {
+        cout << "Loading the second reads with their k-mer index from " << reference_index_file << "..." << std::endl;
+        input2 = load_reference_index(reference_index_file, K, strategy, input_file2);
+        cout << bformat("Reads: %d\n") % input2.reads().size();
+    } else {
+        auto reads2 = PackedReadStore::read_file(input_file2);
+        cout << bformat("Reads: %d\n") % reads2.size();
+        cout << "K-mer index construction of the second reads..." << std::endl;
+        input2 = ReferenceIndex(std::move(reads2), K, strategy);
+    }
+    const PackedReadStore &input_reads2 = input2.reads();
 
     cout << "Reads' length checking..." << std::endl;
     size_t required_read_length = (strategy != 0) ? (K * (tau + strategy)) : 0;
 
     size_t discarded_reads1 = 0;
-    for (const auto &read : input_reads1) {
-        discarded_reads1 += length(read) < required_read_length;
+    for (size_t j = 0; j < input_reads1.size(); ++j) {
+        discarded_reads1 += input_reads1[j].length() < required_read_length;
     }
     size_t discarded_reads2 = 0;
-    for (const auto &read : input_reads2) {
-        discarded_reads2 += length(read) < required_read_length;
+    for (size_t i = 0; i < input_reads2.size(); ++i) {
+        discarded_reads2 += input_reads2[i].length() < required_read_length;
     }
 
     if (discarded_reads1 || discarded_reads2) {
         cout << bformat("Discarded reads %d/%d") % discarded_reads1 % discarded_reads2 << std::endl;
     }
 
-    cout << "K-mer index construction (||)..." << std::endl;
-    // auto kmer2reads1 = kmerIndexConstruction(input_reads1, K);
-    // auto kmer2reads2 = kmerIndexConstruction(input_reads2, K);
-    auto kmer2reads1_fut = async(std::launch::async, [&](){ return kmerIndexConstruction(input_reads1, K); });
-    auto kmer2reads2_fut = async(std::launch::async, [&](){ return kmerIndexConstruction(input_reads2, K); });
+    cout << "K-mer index construction of the first reads..." << std::endl;
+    auto kmer2reads1 = kmerIndexConstruction(input_reads1, K);
+    const KmerIndex &kmer2reads2 = input2.kmer_index();
 
-    auto kmer2reads1 = kmer2reads1_fut.get();
-    auto kmer2reads2 = kmer2reads2_fut.get();
-
-    omp_set_num_threads(nthreads);
     cout << bformat("Strategy %d is used") % strategy << std::endl;
     cout << bformat("Matching (using %d threads)...") % nthreads << std::endl;
 
@@ -289,7 +306,7 @@ int main(int argc, char **argv) {
     };
     */
 
-    auto score_fun = [tau](const Dna5String &s1, const Dna5String &s2) -> int {
+    auto score_fun = [tau](const PackedRead &s1, const PackedRead &s2) -> int {
         auto lizard_tail = [](int) -> int { return 0; };
         return half_sw_banded(s1, s2, 0, -1, -1, lizard_tail, tau);
     };
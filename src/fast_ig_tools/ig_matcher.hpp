@@ -2,46 +2,28 @@
 
 #include <cassert>
 #include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <numeric>
+#include <string>
 #include <vector>
 #include <unordered_map>
 #include <fstream>
 #include <exception>
 #include <verify.hpp>
+#include <openmp_wrapper.h>
+#include <parallel_wrapper.hpp>
 
 #include <seqan/seq_io.h>
 #include "fast_ig_tools.hpp"
+#include "banded_half_smith_waterman.hpp"
+#include "batch_distance.hpp"
+#include "../algorithms/hashes/polyhashes.hpp"
+#include "../graph_utils/const_array.hpp"
 using seqan::length;
 
 
-// TODO Reimplement it as "generator" with O(1) memory consumption
-template<typename T>
-std::vector<size_t> polyhashes(const T &s, size_t K) {
-    if (length(s) < K) {
-        return {  };
-    }
-
-    const size_t p = 7;
-    std::vector<size_t> result(length(s) - K + 1);
-
-    size_t first = 0;
-    size_t p_pow_K = 1;
-    for (size_t i = 0; i < K; ++i) {
-        first *= p;
-        first += unsigned(s[i]);
-        p_pow_K *= p;
-    }
-
-    result[0] = first;
-    for (size_t i = 1; i < result.size(); ++i) {
-        first *= p;
-        first += unsigned(s[K + i - 1]); //size_t(s[K + i - 1]);
-        first -= unsigned(s[i - 1]) * p_pow_K; //size_t(s[i - 1]) * p_pow_K;
-        result[i] = first;
-    }
-
-    return result;
-}
-
 template<typename T1, typename T2 = T1>
 int hamming_rtrim(const T1& s1, const T2 &s2) {
     size_t len = std::min<size_t>(length(s1), length(s2));
@@ -66,25 +48,313 @@ void remove_duplicates(std::vector<T> &v, bool sorted = false) {
 }
 
 
-using KmerIndex = std::unordered_map<size_t, std::vector<size_t>>;
+// Read-only k-mer index in compressed sparse row layout:
+// sorted distinct k-mer hashes, posting list offsets and one contiguous array of read indices.
+// Posting lists are sorted and contain every read at most once
+class KmerIndex {
+public:
+    using ReadIndex = uint32_t;
 
+    class Postings {
+    public:
+        Postings() : begin_{nullptr}, end_{nullptr} {}
+        Postings(const ReadIndex *b, const ReadIndex *e) : begin_{b}, end_{e} {}
 
-template<typename T>
-KmerIndex kmerIndexConstruction(const std::vector<T> &input_reads, size_t K) {
-    size_t initial_hashtable_size = (K <= 13) ? (1 << (2*K)) : (input_reads.size() * 200);
-    KmerIndex kmer2reads(initial_hashtable_size);
+        const ReadIndex *begin() const { return begin_; }
+        const ReadIndex *end() const { return end_; }
+        size_t size() const { return end_ - begin_; }
+        bool empty() const { return begin_ == end_; }
+
+    private:
+        const ReadIndex *begin_;
+        const ReadIndex *end_;
+    };
+
+    KmerIndex() = default;
+    KmerIndex(const KmerIndex &) = delete;
+    KmerIndex &operator=(const KmerIndex &) = delete;
+    KmerIndex(KmerIndex &&) = default;
+    KmerIndex &operator=(KmerIndex &&) = default;
+
+    // TReads is a random-access collection of reads, e.g., std::vector<Dna5String> or PackedReadStore
+    template<typename TReads>
+    KmerIndex(const TReads &input_reads, size_t K) {
+        build(input_reads, K);
+    }
+
+    // Empty postings for absent k-mers
+    Postings find(size_t hash) const {
+        if (keys_.empty()) {
+            return {  };
+        }
+
+        size_t bucket = std::min<size_t>(hash >> shift_, directory_.size() - 2);
+        auto b = keys_.begin() + directory_[bucket];
+        auto e = keys_.begin() + directory_[bucket + 1];
+        auto it = std::lower_bound(b, e, hash);
+        if (it == e || *it != hash) {
+            return {  };
+        }
+
+        size_t i = it - keys_.begin();
+        return { postings_.data() + offsets_[i], postings_.data() + offsets_[i + 1] };
+    }
+
+    size_t size() const {
+        return keys_.size();
+    }
+
+    size_t num_postings() const {
+        return postings_.size();
+    }
+
+    size_t K() const {
+        return K_;
+    }
+
+    // The number of indexed reads
+    size_t num_reads() const {
+        return num_reads_;
+    }
+
+    // Binary dump: header, keys, offsets and postings
+    void save(const std::string &filename) const {
+        Header header = { { 'I', 'G', 'R', 'K', 'I', 'D', 'X', '\0' }, kVersion, static_cast<uint32_t>(K_),
+                          num_reads_, keys_.size(), postings_.size() };
+        std::ofstream out(filename, std::ios::binary);
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        write_array(out, keys_);
+        write_array(out, offsets_);
+        write_array(out, postings_);
+        VERIFY_MSG(out.good(), "Failed to write k-mer index to " << filename);
+    }
+
+    static KmerIndex load(const std::string &filename) {
+        Header header;
+        std::ifstream in(filename, std::ios::binary);
+        VERIFY_MSG(in.read(reinterpret_cast<char*>(&header), sizeof(header)), "Cannot read k-mer index " << filename);
+        VERIFY_MSG(std::string(header.magic, sizeof(header.magic)) == std::string("IGRKIDX\0", 8),
+                   "File " << filename << " is not a k-mer index");
+        VERIFY_MSG(header.version == kVersion, "Unsupported version " << header.version << " of k-mer index " << filename);
+
+        std::vector<size_t> keys(header.num_keys);
+        std::vector<size_t> offsets(header.num_keys + 1);
+        std::vector<ReadIndex> postings(header.num_postings);
+        VERIFY_MSG(read_array(in, keys) && read_array(in, offsets) && read_array(in, postings),
+                   "K-mer index " << filename << " is truncated");
+
+        KmerIndex index;
+        index.K_ = header.K;
+        index.num_reads_ = header.num_reads;
+        index.keys_ = std::move(keys);
+        index.offsets_ = std::move(offsets);
+        index.postings_ = std::move(postings);
+        index.build_directory();
+        return index;
+    }
+
+    // Index of base reads followed by delta reads, i.e., read j of delta gets index base.num_reads() + j
+    static KmerIndex merge(const KmerIndex &base, const KmerIndex &delta) {
+        VERIFY(base.K_ == delta.K_);
+        VERIFY(base.num_reads_ + delta.num_reads_ <= std::numeric_limits<ReadIndex>::max());
+
+        std::vector<size_t> keys;
+        std::vector<size_t> offsets;
+        std::vector<ReadIndex> postings;
+        keys.reserve(base.keys_.size() + delta.keys_.size());
+        offsets.reserve(base.keys_.size() + delta.keys_.size() + 1);
+        postings.reserve(base.postings_.size() + delta.postings_.size());
+        offsets.push_back(0);
+
+        const ReadIndex shift = static_cast<ReadIndex>(base.num_reads_);
+        for (size_t i = 0, j = 0; i < base.keys_.size() || j < delta.keys_.size(); ) {
+            bool from_base = j == delta.keys_.size() || (i < base.keys_.size() && base.keys_[i] <= delta.keys_[j]);
+            bool from_delta = i == base.keys_.size() || (j < delta.keys_.size() && delta.keys_[j] <= base.keys_[i]);
+            keys.push_back(from_base ? base.keys_[i] : delta.keys_[j]);
+            if (from_base) {
+                postings.insert(postings.end(),
+                                base.postings_.begin() + base.offsets_[i],
+                                base.postings_.begin() + base.offsets_[i + 1]);
+                ++i;
+            }
+            if (from_delta) {
+                for (size_t p = delta.offsets_[j]; p < delta.offsets_[j + 1]; ++p) {
+                    postings.push_back(delta.postings_[p] + shift);
+                }
+                ++j;
+            }
+            offsets.push_back(postings.size());
+        }
+
+        KmerIndex index;
+        index.K_ = base.K_;
+        index.num_reads_ = base.num_reads_ + delta.num_reads_;
+        index.keys_ = std::move(keys);
+        index.offsets_ = std::move(offsets);
+        index.postings_ = std::move(postings);
+        index.build_directory();
+        return index;
+    }
+
+private:
+    friend class ReferenceIndex;
+
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t K;
+        uint64_t num_reads;
+        uint64_t num_keys;
+        uint64_t num_postings;
+    };
+
+    static const uint32_t kVersion = 1;
+
+    template<typename T>
+    static void write_array(std::ofstream &out, const ConstArray<T> &v) {
+        out.write(reinterpret_cast<const char*>(v.data()), static_cast<std::streamsize>(v.size() * sizeof(T)));
+    }
+
+    template<typename T>
+    static bool read_array(std::ifstream &in, std::vector<T> &v) {
+        return bool(in.read(reinterpret_cast<char*>(v.data()), static_cast<std::streamsize>(v.size() * sizeof(T))));
+    }
+
+    size_t K_ = 0;
+    size_t num_reads_ = 0;
+    ConstArray<size_t> keys_;
+    ConstArray<size_t> offsets_;
+    ConstArray<ReadIndex> postings_;
+
+    // directory_[b] is the first key with (key >> shift_) >= b
+    ConstArray<size_t> directory_;
+    unsigned shift_ = 0;
 
-    for (size_t j = 0; j < input_reads.size(); ++j) {
-        for (size_t hash : polyhashes(input_reads[j], K)) {
-            kmer2reads[hash].push_back(j); // Already sorted. Nice!
+    size_t key_index(size_t hash) const {
+        return std::lower_bound(keys_.begin(), keys_.end(), hash) - keys_.begin();
+    }
+
+    template<typename T>
+    static void read_distinct_kmers(const T &read, size_t K, std::vector<size_t> &hashes) {
+        hashes.clear();
+        for (const auto &kmer : algorithms::kmer_hashes(read, K)) {
+            hashes.push_back(kmer.hash);
+        }
+        remove_duplicates(hashes);
+    }
+
+    void build_directory() {
+        size_t max_key = keys_.empty() ? 0 : keys_[keys_.size() - 1];
+        unsigned key_bits = 0;
+        while (key_bits < 64 && (max_key >> key_bits)) {
+            ++key_bits;
+        }
+        unsigned dir_bits = 1;
+        while (dir_bits < 20 && (size_t(4) << dir_bits) < keys_.size()) {
+            ++dir_bits;
+        }
+        shift_ = (key_bits > dir_bits) ? key_bits - dir_bits : 0;
+
+        std::vector<size_t> directory((max_key >> shift_) + 2, 0);
+        for (size_t bucket = 0, i = 0; bucket < directory.size(); ++bucket) {
+            while (i < keys_.size() && (keys_[i] >> shift_) < bucket) {
+                ++i;
+            }
+            directory[bucket] = i;
         }
+        directory_ = std::move(directory);
     }
 
-    for (auto &kv : kmer2reads) {
-        remove_duplicates(kv.second, true);
+    // Parallel construction: collect distinct k-mers, count posting list sizes, prefix-sum, scatter
+    template<typename TReads>
+    void build(const TReads &input_reads, size_t K) {
+        VERIFY(input_reads.size() <= std::numeric_limits<ReadIndex>::max());
+        K_ = K;
+        num_reads_ = input_reads.size();
+
+        const size_t nthreads = omp_get_max_threads();
+        std::vector<std::vector<size_t>> local_keys(nthreads);
+
+        SEQAN_OMP_PRAGMA(parallel)
+        {
+            auto &local = local_keys[omp_get_thread_num()];
+            SEQAN_OMP_PRAGMA(for schedule(static))
+            for (size_t j = 0; j < input_reads.size(); ++j) {
+                const auto &read = input_reads[j];
+                for (const auto &kmer : algorithms::kmer_hashes(read, K)) {
+                    local.push_back(kmer.hash);
+                }
+            }
+            remove_duplicates(local);
+        }
+
+        std::vector<size_t> keys;
+        for (auto &local : local_keys) {
+            keys.insert(keys.end(), local.cbegin(), local.cend());
+            std::vector<size_t>().swap(local);
+        }
+        parallel::sort(keys.begin(), keys.end());
+        remove_duplicates(keys, true);
+        keys.shrink_to_fit();
+        keys_ = std::move(keys);
+
+        // Count
+        std::vector<size_t> counts(keys_.size() + 1, 0);
+        SEQAN_OMP_PRAGMA(parallel)
+        {
+            std::vector<size_t> hashes;
+            SEQAN_OMP_PRAGMA(for schedule(dynamic, 64))
+            for (size_t j = 0; j < input_reads.size(); ++j) {
+                read_distinct_kmers(input_reads[j], K, hashes);
+                for (size_t hash : hashes) {
+                    size_t i = key_index(hash);
+                    SEQAN_OMP_PRAGMA(atomic)
+                    ++counts[i];
+                }
+            }
+        }
+
+        // Prefix sum
+        std::vector<size_t> offsets(keys_.size() + 1);
+        offsets[0] = 0;
+        for (size_t i = 0; i < keys_.size(); ++i) {
+            offsets[i + 1] = offsets[i] + counts[i];
+        }
+
+        // Scatter
+        std::copy(offsets.cbegin(), offsets.cend(), counts.begin());
+        std::vector<ReadIndex> postings(offsets.back());
+        SEQAN_OMP_PRAGMA(parallel)
+        {
+            std::vector<size_t> hashes;
+            SEQAN_OMP_PRAGMA(for schedule(dynamic, 64))
+            for (size_t j = 0; j < input_reads.size(); ++j) {
+                read_distinct_kmers(input_reads[j], K, hashes);
+                for (size_t hash : hashes) {
+                    size_t i = key_index(hash);
+                    size_t pos;
+                    SEQAN_OMP_PRAGMA(atomic capture)
+                    pos = counts[i]++;
+                    postings[pos] = static_cast<ReadIndex>(j);
+                }
+            }
+        }
+
+        SEQAN_OMP_PRAGMA(parallel for schedule(dynamic, 1024))
+        for (size_t i = 0; i < keys_.size(); ++i) {
+            std::sort(postings.begin() + offsets[i], postings.begin() + offsets[i + 1]);
+        }
+
+        offsets_ = std::move(offsets);
+        postings_ = std::move(postings);
+        build_directory();
     }
+};
 
-    return kmer2reads;
+
+template<typename TReads>
+KmerIndex kmerIndexConstruction(const TReads &input_reads, size_t K) {
+    return KmerIndex(input_reads, K);
 }
 
 
@@ -96,146 +366,707 @@ size_t count_unique(std::vector<T> v) {
 }
 
 
+// Per-thread buffers reused by find_candidates between queries, so that candidate search does not allocate
+// once the buffers have grown to their working size
+struct CandidateScratch {
+    std::vector<size_t> multiplicities;
+    std::vector<size_t> coverage;
+    std::vector<size_t> coverage_workspace;
+    std::vector<uint32_t> hits; // Dense hit counters indexed by target read, all zeros between queries
+    std::vector<size_t> touched;
+    std::vector<size_t> candidates;
+    std::vector<size_t> verified; // Candidates passed to verify_candidates and their distances
+    std::vector<size_t> dists;
+};
+
+
+// Positions of tau + strategy non-overlapping k-mers of read with the minimal total number of occurrences
+// are stored in scratch.coverage, occurrences of all k-mers of read are stored in scratch.multiplicities.
+// Occurrences in other_kmer2reads are counted too if it is given
+template<typename T>
+void select_anchor_kmers(const T &read,
+                         const KmerIndex &kmer2reads,
+                         unsigned tau, size_t K,
+                         unsigned strategy,
+                         CandidateScratch &scratch,
+                         const KmerIndex *other_kmer2reads = nullptr) {
+    auto &multiplicities = scratch.multiplicities;
+    multiplicities.clear();
+    for (const auto &kmer : algorithms::kmer_hashes(read, K)) {
+        size_t multiplicity = kmer2reads.find(kmer.hash).size();
+        if (other_kmer2reads) {
+            multiplicity += other_kmer2reads->find(kmer.hash).size();
+        }
+        multiplicities.push_back(multiplicity);
+    }
+
+    optimal_coverage(multiplicities, K, tau + strategy, scratch.coverage, scratch.coverage_workspace);
+}
+
+
+// Returns sorted indices of candidate target reads, the result is stored in scratch.
+// If other_kmer2reads is given, anchors are selected as if both indices were a single one, so that candidates
+// are the ones found in the index of the union of their reads
 template<typename T>
-std::vector<size_t> find_candidates(const T &read,
-                                    const KmerIndex &kmer2reads,
-                                    size_t target_size,
-                                    unsigned tau, size_t K,
-                                    unsigned strategy) {
+const std::vector<size_t>& find_candidates(const T &read,
+                                           const KmerIndex &kmer2reads,
+                                           size_t target_size,
+                                           unsigned tau, size_t K,
+                                           unsigned strategy,
+                                           CandidateScratch &scratch,
+                                           const KmerIndex *other_kmer2reads = nullptr) {
+    auto &cand = scratch.candidates;
+    cand.clear();
+
     size_t required_read_length = (strategy != 0) ? (K * (tau + strategy)) : 0;
     if (length(read) < required_read_length) {
-        return {  };
+        return cand;
     }
 
-    std::vector<size_t> cand;
-
     if (strategy == 0) { // Simple O(N*M) strategy
         cand.resize(target_size);
         std::iota(cand.begin(), cand.end(), 0);
     } else { // Minimizers strategy
-        std::vector<size_t> multiplicities;
+        select_anchor_kmers(read, kmer2reads, tau, K, strategy, scratch, other_kmer2reads);
 
-        auto hashes = polyhashes(read, K);
+        auto &hits = scratch.hits;
+        auto &touched = scratch.touched;
+        if (hits.size() < target_size) {
+            hits.resize(target_size, 0);
+        }
+        touched.clear();
+        for (size_t i : scratch.coverage) {
+            for (size_t candidate_index : kmer2reads.find(algorithms::kmer_hash(read, i, K))) {
+                if (hits[candidate_index]++ == 0) {
+                    touched.push_back(candidate_index);
+                }
+            }
+        }
 
-        multiplicities.reserve(hashes.size());
-        for (size_t hash : hashes) {
-            auto it = kmer2reads.find(hash);
-            if (it != kmer2reads.cend()) {
-                multiplicities.push_back(it->second.size());
-            } else {
-                multiplicities.push_back(0);
+        for (size_t candidate_index : touched) {
+            if (hits[candidate_index] >= strategy) {
+                cand.push_back(candidate_index);
             }
+            hits[candidate_index] = 0;
         }
+        std::sort(cand.begin(), cand.end());
+    }
 
-        std::vector<size_t> ind = optimal_coverage(multiplicities, K, tau + strategy);
+    return cand;
+}
 
-        std::unordered_map<size_t, size_t> hits;
-        for (size_t i : ind) {
-            size_t hash = hashes[i];
-            auto it = kmer2reads.find(hash);
-            if (it != kmer2reads.cend()) {
-                for (size_t candidate_index : it->second) {
-                    ++hits[candidate_index];
-                }
-            }
+
+// Upper bound of the number of candidates of read, i.e., the total size of posting lists scanned by find_candidates.
+// It is much cheaper than find_candidates itself (cf. find_candidates_num of ig_hgc_complexity_estimator)
+template<typename T>
+size_t predicted_candidates_num(const T &read,
+                                const KmerIndex &kmer2reads,
+                                size_t target_size,
+                                unsigned tau, size_t K,
+                                unsigned strategy,
+                                CandidateScratch &scratch) {
+    size_t required_read_length = (strategy != 0) ? (K * (tau + strategy)) : 0;
+    if (length(read) < required_read_length) {
+        return 0;
+    }
+
+    if (strategy == 0) {
+        return target_size;
+    }
+
+    select_anchor_kmers(read, kmer2reads, tau, K, strategy, scratch);
+    size_t result = 0;
+    for (size_t i : scratch.coverage) {
+        result += scratch.multiplicities[i];
+    }
+    return result;
+}
+
+
+// Half-open range of query reads [begin, end), e.g., the part of input processed by a single shard
+struct ReadRange {
+    size_t begin;
+    size_t end;
+
+    static ReadRange All() { return { 0, std::numeric_limits<size_t>::max() }; }
+
+    // i-th of num_shards nearly equal parts of [0, size)
+    static ReadRange Shard(size_t size, size_t i, size_t num_shards) {
+        return { size * i / num_shards, size * (i + 1) / num_shards };
+    }
+};
+
+
+// Distribution of queries among threads. Candidate counts of expanded clonotypes are orders of magnitude larger
+// than ones of singletons, so queries are ordered by predicted cost (the heaviest first) and handed out one by one
+// to idle threads. Otherwise, queries are processed in input order by chunks
+struct QuerySchedule {
+    bool by_cost = true;
+
+    // Seconds between progress reports (INFO) during query processing, 0 disables them
+    double progress_interval = 0;
+
+    // Output: time each thread spent on queries, in seconds
+    std::vector<double> busy_time;
+
+    // Output, summed over threads: candidates found in the index, distance computations and edges found
+    // (before symmetrization), time of candidate generation and verification (thread-seconds)
+    size_t candidates = 0;
+    size_t dist_computations = 0;
+    size_t edges = 0;
+    double candidates_time = 0;
+    double verification_time = 0;
+
+    // Output: wall-clock time of query ordering and of assembly of the graph from per-thread edges, in seconds
+    double ordering_time = 0;
+    double assembly_time = 0;
+};
+
+
+// Counters of queries processed in parallel. Every thread updates only its own counters and merely reads
+// those of other threads for progress reports, so relaxed stores are enough and no cache line bounces
+// between threads. Reports are made by whichever thread first notices that the interval has passed
+class QueryProgress {
+public:
+    QueryProgress(size_t num_queries, double report_interval) :
+            counters_(omp_get_max_threads()),
+            num_queries_(num_queries),
+            report_interval_(report_interval),
+            start_time_(omp_get_wtime()) {
+        next_report_ = start_time_ + report_interval;
+    }
+
+    // Called by the thread that has processed a query
+    void add(size_t candidates, size_t dist_computations, size_t edges,
+             double candidates_time, double verification_time) {
+        Counters &counters = counters_[omp_get_thread_num()];
+        increase(counters.queries, 1);
+        increase(counters.candidates, candidates);
+        increase(counters.dist_computations, dist_computations);
+        increase(counters.edges, edges);
+        counters.candidates_time += candidates_time;
+        counters.verification_time += verification_time;
+
+        if (report_interval_ > 0) {
+            report_if_due();
         }
+    }
 
-        for (const auto &kv : hits) {
-            if (kv.second >= strategy) {
-                cand.push_back(kv.first);
+    // Sums over threads, must be called after the parallel region
+    void merge(size_t &num_of_dist_computations, QuerySchedule *schedule) const {
+        num_of_dist_computations = 0;
+        for (const Counters &counters : counters_) {
+            num_of_dist_computations += counters.dist_computations.load(std::memory_order_relaxed);
+            if (schedule) {
+                schedule->candidates += counters.candidates.load(std::memory_order_relaxed);
+                schedule->edges += counters.edges.load(std::memory_order_relaxed);
+                schedule->candidates_time += counters.candidates_time;
+                schedule->verification_time += counters.verification_time;
             }
         }
+        if (schedule) {
+            schedule->dist_computations += num_of_dist_computations;
+        }
     }
 
-    return cand;
+private:
+    // 64 bytes of padding keep counters of neighbouring threads in different cache lines
+    struct Counters {
+        std::atomic<size_t> queries{0};
+        std::atomic<size_t> candidates{0};
+        std::atomic<size_t> dist_computations{0};
+        std::atomic<size_t> edges{0};
+        double candidates_time = 0;
+        double verification_time = 0;
+        char padding[64];
+    };
+
+    std::vector<Counters> counters_;
+    size_t num_queries_;
+    double report_interval_;
+    double start_time_;
+    std::atomic<double> next_report_;
+
+    static void increase(std::atomic<size_t> &counter, size_t value) {
+        counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+    }
+
+    void report_if_due() {
+        double now = omp_get_wtime();
+        double next_report = next_report_.load(std::memory_order_relaxed);
+        if (now < next_report || !next_report_.compare_exchange_strong(next_report, now + report_interval_)) {
+            return;
+        }
+
+        size_t queries = 0, candidates = 0, edges = 0;
+        for (const Counters &counters : counters_) {
+            queries += counters.queries.load(std::memory_order_relaxed);
+            candidates += counters.candidates.load(std::memory_order_relaxed);
+            edges += counters.edges.load(std::memory_order_relaxed);
+        }
+
+        // The heaviest queries go first in cost order, so the estimate is pessimistic
+        double elapsed = now - start_time_;
+        double eta = queries ? elapsed * static_cast<double>(num_queries_ - queries) / static_cast<double>(queries) : 0;
+        INFO(bformat("Processed %d of %d reads (%0.1f%%), %0.0f candidates/s, %d edges found, ETA %s")
+             % queries % num_queries_ % (100. * static_cast<double>(queries) / static_cast<double>(std::max<size_t>(num_queries_, 1)))
+             % (elapsed > 0 ? static_cast<double>(candidates) / elapsed : 0.) % edges % human_readable_time(eta));
+    }
+};
+
+
+// Queries [begin, end) in the order of processing
+template<typename TReads>
+std::vector<size_t> query_order(const TReads &input_reads,
+                                const KmerIndex &kmer2reads,
+                                size_t target_size,
+                                unsigned tau, size_t K,
+                                unsigned strategy,
+                                size_t begin, size_t end,
+                                bool by_cost) {
+    std::vector<size_t> order(end - begin);
+    std::iota(order.begin(), order.end(), begin);
+    if (!by_cost) {
+        return order;
+    }
+
+    std::vector<std::pair<size_t, size_t>> costs(order.size());
+    SEQAN_OMP_PRAGMA(parallel)
+    {
+        CandidateScratch scratch;
+        SEQAN_OMP_PRAGMA(for schedule(dynamic, 64))
+        for (size_t q = 0; q < order.size(); ++q) {
+            costs[q] = { predicted_candidates_num(input_reads[order[q]], kmer2reads, target_size, tau, K, strategy,
+                                                  scratch),
+                         order[q] };
+        }
+    }
+
+    // The heaviest first, ties in input order
+    parallel::sort(costs.begin(), costs.end(),
+                   [](const std::pair<size_t, size_t> &a, const std::pair<size_t, size_t> &b) {
+                       return a.first > b.first || (a.first == b.first && a.second < b.second);
+                   });
+    for (size_t q = 0; q < order.size(); ++q) {
+        order[q] = costs[q].second;
+    }
+    return order;
 }
 
 
-template<typename T, typename Tf>
-Graph tauDistGraph(const std::vector<T> &input_reads,
-                   const KmerIndex &kmer2reads,
-                   const Tf &dist_fun,
-                   unsigned tau,
-                   unsigned K,
-                   unsigned strategy,
-                   size_t &num_of_dist_computations) {
-    Graph g(input_reads.size());
+// TReads is a random-access collection of reads, e.g., std::vector<Dna5String> or PackedReadStore.
+// Tbounded_dist(s1, s2) returns the distance between s1 and s2 if it does not exceed tau and something greater otherwise.
+// Only queries in the given range are processed, the graph still contains all input_reads.size() vertices.
+// If input reads were reordered (see read_order.hpp), original_ids are their indices in the initial order:
+// distance between reads of equal length is computed from the one that was the first initially,
+// so that the graph is the same as that of the initial order up to renumbering
+template<typename TReads, typename Tbounded_dist>
+CsrGraph tauDistGraphBounded(const TReads &input_reads,
+                             const KmerIndex &kmer2reads,
+                             const Tbounded_dist &bounded_dist,
+                             unsigned tau,
+                             unsigned K,
+                             unsigned strategy,
+                             size_t &num_of_dist_computations,
+                             ReadRange queries = ReadRange::All(),
+                             QuerySchedule *schedule = nullptr,
+                             const std::vector<size_t> *original_ids = nullptr) {
+    // Every pair is examined only once (from the shorter read), so edges are collected in per-thread
+    // buffers and then scattered in both directions right into CSR arrays
+    std::vector<std::vector<WeightedEdge>> buffers(omp_get_max_threads());
+    std::vector<double> busy_time(omp_get_max_threads(), 0);
 
-    std::atomic<size_t> atomic_num_of_dist_computations;
-    atomic_num_of_dist_computations = 0;
+    size_t queries_end = std::min(queries.end, input_reads.size());
+    size_t queries_begin = std::min(queries.begin, queries_end);
+    bool by_cost = !schedule || schedule->by_cost;
+    double ordering_start = omp_get_wtime();
+    auto order = query_order(input_reads, kmer2reads, input_reads.size(), tau, K, strategy,
+                             queries_begin, queries_end, by_cost);
+    double ordering_time = omp_get_wtime() - ordering_start;
+    int chunk = by_cost ? 1 : 8;
 
-    SEQAN_OMP_PRAGMA(parallel for schedule(dynamic, 8))
-    for (size_t j = 0; j < input_reads.size(); ++j) {
-        auto cand = find_candidates(input_reads[j], kmer2reads, input_reads.size(), tau, K, strategy);
+    QueryProgress progress(order.size(), schedule ? schedule->progress_interval : 0);
 
-        size_t len_j = length(input_reads[j]);
+    SEQAN_OMP_PRAGMA(parallel)
+    {
+        CandidateScratch scratch;
+        std::vector<WeightedEdge> local_edges;
+        double start_time = omp_get_wtime();
 
-        for (size_t i : cand) {
-            size_t len_i = length(input_reads[i]);
-            if (len_j < len_i || (len_i == len_j && j < i)) {
-                size_t dist = dist_fun(input_reads[j], input_reads[i]);
+        SEQAN_OMP_PRAGMA(for schedule(dynamic, chunk) nowait)
+        for (size_t q = 0; q < order.size(); ++q) {
+            double query_start = omp_get_wtime();
+            size_t j = order[q];
+            const auto &cand = find_candidates(input_reads[j], kmer2reads, input_reads.size(), tau, K, strategy,
+                                               scratch);
 
-                atomic_num_of_dist_computations += 1;
+            size_t len_j = length(input_reads[j]);
+            size_t id_j = original_ids ? (*original_ids)[j] : j;
 
-                if (dist <= tau) {
-                    g[j].push_back( { i, dist } );
+            auto &verified = scratch.verified;
+            verified.clear();
+            for (size_t i : cand) {
+                size_t len_i = length(input_reads[i]);
+                if (len_j < len_i || (len_i == len_j && id_j < (original_ids ? (*original_ids)[i] : i))) {
+                    verified.push_back(i);
                 }
             }
+
+            double verification_start = omp_get_wtime();
+            verify_candidates(bounded_dist, input_reads[j], input_reads, verified, scratch.dists);
+
+            size_t edges_before = local_edges.size();
+            for (size_t k = 0; k < verified.size(); ++k) {
+                if (scratch.dists[k] <= tau) {
+                    local_edges.push_back( { j, verified[k], static_cast<int>(scratch.dists[k]) } );
+                }
+            }
+
+            double query_end = omp_get_wtime();
+            progress.add(cand.size(), verified.size(), local_edges.size() - edges_before,
+                         verification_start - query_start, query_end - verification_start);
         }
+
+        busy_time[omp_get_thread_num()] = omp_get_wtime() - start_time;
+        buffers[omp_get_thread_num()] = std::move(local_edges);
     }
 
-    // Undirecting
-    auto gg = g;
-    for (size_t i = 0; i < gg.size(); ++i) {
-        for (const auto &_ : gg[i]) {
-            g[_.first].push_back( { i, _.second } );
-        }
+    progress.merge(num_of_dist_computations, schedule);
+
+    double assembly_start = omp_get_wtime();
+    auto graph = CsrGraph::FromEdgeBuffers(input_reads.size(), buffers, true);
+    if (schedule) {
+        schedule->busy_time = std::move(busy_time);
+        schedule->ordering_time += ordering_time;
+        schedule->assembly_time += omp_get_wtime() - assembly_start;
     }
-    gg.clear(); // Free memory
 
-    SEQAN_OMP_PRAGMA(parallel for schedule(guided, 8))
-    for (size_t j = 0; j < g.size(); ++j) {
-        remove_duplicates(g[j]);
+    return graph;
+}
+
+
+template<typename TReads, typename Tbounded_dist>
+CsrGraph tauMatchGraphBounded(const TReads &input_reads,
+                              const TReads &reference_reads,
+                              const KmerIndex &kmer2reads,
+                              const Tbounded_dist &bounded_dist,
+                              unsigned tau,
+                              unsigned K,
+                              unsigned strategy,
+                              size_t &num_of_dist_computations,
+                              ReadRange queries = ReadRange::All(),
+                              QuerySchedule *schedule = nullptr) {
+    std::vector<std::vector<WeightedEdge>> buffers(omp_get_max_threads());
+    std::vector<double> busy_time(omp_get_max_threads(), 0);
+
+    size_t queries_end = std::min(queries.end, input_reads.size());
+    size_t queries_begin = std::min(queries.begin, queries_end);
+    bool by_cost = !schedule || schedule->by_cost;
+    double ordering_start = omp_get_wtime();
+    auto order = query_order(input_reads, kmer2reads, reference_reads.size(), tau, K, strategy,
+                             queries_begin, queries_end, by_cost);
+    double ordering_time = omp_get_wtime() - ordering_start;
+    int chunk = by_cost ? 1 : 8;
+
+    QueryProgress progress(order.size(), schedule ? schedule->progress_interval : 0);
+
+    SEQAN_OMP_PRAGMA(parallel)
+    {
+        CandidateScratch scratch;
+        std::vector<WeightedEdge> local_edges;
+        double start_time = omp_get_wtime();
+
+        SEQAN_OMP_PRAGMA(for schedule(dynamic, chunk) nowait)
+        for (size_t q = 0; q < order.size(); ++q) {
+            double query_start = omp_get_wtime();
+            size_t j = order[q];
+            const auto &cand = find_candidates(input_reads[j], kmer2reads, reference_reads.size(), tau, K, strategy,
+                                               scratch);
+
+            double verification_start = omp_get_wtime();
+            verify_candidates(bounded_dist, input_reads[j], reference_reads, cand, scratch.dists);
+
+            size_t edges_before = local_edges.size();
+            for (size_t k = 0; k < cand.size(); ++k) {
+                if (scratch.dists[k] <= tau) {
+                    local_edges.push_back( { j, cand[k], static_cast<int>(scratch.dists[k]) } );
+                }
+            }
+
+            double query_end = omp_get_wtime();
+            progress.add(cand.size(), cand.size(), local_edges.size() - edges_before,
+                         verification_start - query_start, query_end - verification_start);
+        }
+
+        busy_time[omp_get_thread_num()] = omp_get_wtime() - start_time;
+        buffers[omp_get_thread_num()] = std::move(local_edges);
     }
 
-    num_of_dist_computations = atomic_num_of_dist_computations;
+    progress.merge(num_of_dist_computations, schedule);
 
-    return g;
+    double assembly_start = omp_get_wtime();
+    auto graph = CsrGraph::FromEdgeBuffers(input_reads.size(), buffers, false);
+    if (schedule) {
+        schedule->busy_time = std::move(busy_time);
+        schedule->ordering_time += ordering_time;
+        schedule->assembly_time += omp_get_wtime() - assembly_start;
+    }
+
+    return graph;
 }
 
 
-template<typename T, typename Tf>
-Graph tauMatchGraph(const std::vector<T> &input_reads,
-                    const std::vector<T> &reference_reads,
-                    const KmerIndex &kmer2reads,
-                    const Tf &dist_fun,
-                    unsigned tau,
-                    unsigned K,
-                    unsigned strategy,
-                    size_t &num_of_dist_computations) {
-    Graph g(input_reads.size());
+// Edges of the graph on base_reads followed by new_reads that involve new reads, i.e., new x base and new x new ones.
+// New read j is vertex base_reads.size() + j. As in tauDistGraphBounded, candidates of every pair are searched
+// from the shorter read (the base one if lengths are equal) and distances are oriented from it, so the graph is
+// the same as the one built from scratch. Anchors are selected by k-mer occurrences in both indices for the same
+// reason. Thus, new reads are queried against base reads that are longer and
+// against new reads, and base reads that are not longer than some new read are queried against new reads only
+template<typename TReads, typename Tbounded_dist>
+CsrGraph tauIncrementGraphBounded(const TReads &base_reads,
+                                  const TReads &new_reads,
+                                  const KmerIndex &base_kmer2reads,
+                                  const KmerIndex &new_kmer2reads,
+                                  const Tbounded_dist &bounded_dist,
+                                  unsigned tau,
+                                  unsigned K,
+                                  unsigned strategy,
+                                  size_t &num_of_dist_computations,
+                                  QuerySchedule *schedule = nullptr) {
+    const size_t base_size = base_reads.size();
+    std::vector<std::vector<WeightedEdge>> buffers(omp_get_max_threads());
+    std::vector<double> busy_time(omp_get_max_threads(), 0);
+    bool by_cost = !schedule || schedule->by_cost;
+    int chunk = by_cost ? 1 : 8;
+
+    size_t max_new_length = 0;
+    for (size_t j = 0; j < new_reads.size(); ++j) {
+        max_new_length = std::max<size_t>(max_new_length, length(new_reads[j]));
+    }
+
+    double ordering_start = omp_get_wtime();
+    auto new_order = query_order(new_reads, base_kmer2reads, base_size, tau, K, strategy,
+                                 0, new_reads.size(), by_cost);
+    auto base_order = query_order(base_reads, new_kmer2reads, new_reads.size(), tau, K, strategy,
+                                  0, base_size, by_cost);
+    base_order.erase(std::remove_if(base_order.begin(), base_order.end(),
+                                    [&base_reads, max_new_length](size_t i) {
+                                        return length(base_reads[i]) > max_new_length;
+                                    }),
+                     base_order.end());
+    double ordering_time = omp_get_wtime() - ordering_start;
+
+    // New x base (longer base reads) and new x new
+    QueryProgress new_progress(new_order.size(), schedule ? schedule->progress_interval : 0);
+    SEQAN_OMP_PRAGMA(parallel)
+    {
+        CandidateScratch scratch;
+        std::vector<WeightedEdge> &local_edges = buffers[omp_get_thread_num()];
+        double start_time = omp_get_wtime();
+
+        SEQAN_OMP_PRAGMA(for schedule(dynamic, chunk) nowait)
+        for (size_t q = 0; q < new_order.size(); ++q) {
+            size_t j = new_order[q];
+            size_t len_j = length(new_reads[j]);
+            auto &verified = scratch.verified;
+            size_t num_candidates = 0, num_verified = 0, edges_before = local_edges.size();
+            double candidates_time = 0, verification_time = 0;
+
+            double start = omp_get_wtime();
+            const auto &base_cand = find_candidates(new_reads[j], base_kmer2reads, base_size, tau, K, strategy,
+                                                    scratch, &new_kmer2reads);
+            num_candidates += base_cand.size();
+            verified.clear();
+            for (size_t i : base_cand) {
+                if (length(base_reads[i]) > len_j) {
+                    verified.push_back(i);
+                }
+            }
+            double verification_start = omp_get_wtime();
+            verify_candidates(bounded_dist, new_reads[j], base_reads, verified, scratch.dists);
+            for (size_t k = 0; k < verified.size(); ++k) {
+                if (scratch.dists[k] <= tau) {
+                    local_edges.push_back( { verified[k], base_size + j, static_cast<int>(scratch.dists[k]) } );
+                }
+            }
+            num_verified += verified.size();
+            double end = omp_get_wtime();
+            candidates_time += verification_start - start;
+            verification_time += end - verification_start;
+
+            start = end;
+            const auto &new_cand = find_candidates(new_reads[j], new_kmer2reads, new_reads.size(), tau, K, strategy,
+                                                   scratch, &base_kmer2reads);
+            num_candidates += new_cand.size();
+            verified.clear();
+            for (size_t i : new_cand) {
+                size_t len_i = length(new_reads[i]);
+                if (len_j < len_i || (len_i == len_j && j < i)) {
+                    verified.push_back(i);
+                }
+            }
+            verification_start = omp_get_wtime();
+            verify_candidates(bounded_dist, new_reads[j], new_reads, verified, scratch.dists);
+            for (size_t k = 0; k < verified.size(); ++k) {
+                if (scratch.dists[k] <= tau) {
+                    local_edges.push_back( { base_size + j, base_size + verified[k],
+                                             static_cast<int>(scratch.dists[k]) } );
+                }
+            }
+            num_verified += verified.size();
+            end = omp_get_wtime();
+            candidates_time += verification_start - start;
+            verification_time += end - verification_start;
+
+            new_progress.add(num_candidates, num_verified, local_edges.size() - edges_before,
+                             candidates_time, verification_time);
+        }
+
+        busy_time[omp_get_thread_num()] += omp_get_wtime() - start_time;
+    }
 
-    std::atomic<size_t> atomic_num_of_dist_computations;
-    atomic_num_of_dist_computations = 0;
+    // Base x new (not shorter new reads)
+    QueryProgress base_progress(base_order.size(), schedule ? schedule->progress_interval : 0);
+    SEQAN_OMP_PRAGMA(parallel)
+    {
+        CandidateScratch scratch;
+        std::vector<WeightedEdge> &local_edges = buffers[omp_get_thread_num()];
+        double start_time = omp_get_wtime();
 
-    SEQAN_OMP_PRAGMA(parallel for schedule(dynamic, 8))
-    for (size_t j = 0; j < input_reads.size(); ++j) {
-        auto cand = find_candidates(input_reads[j], kmer2reads, reference_reads.size(), tau, K, strategy);
+        SEQAN_OMP_PRAGMA(for schedule(dynamic, chunk) nowait)
+        for (size_t q = 0; q < base_order.size(); ++q) {
+            double query_start = omp_get_wtime();
+            size_t i = base_order[q];
+            size_t len_i = length(base_reads[i]);
+            const auto &cand = find_candidates(base_reads[i], new_kmer2reads, new_reads.size(), tau, K, strategy,
+                                               scratch, &base_kmer2reads);
 
-        for (size_t i : cand) {
-            unsigned dist = dist_fun(input_reads[j], reference_reads[i]);
+            auto &verified = scratch.verified;
+            verified.clear();
+            for (size_t j : cand) {
+                if (length(new_reads[j]) >= len_i) {
+                    verified.push_back(j);
+                }
+            }
 
-            atomic_num_of_dist_computations += 1;
+            double verification_start = omp_get_wtime();
+            verify_candidates(bounded_dist, base_reads[i], new_reads, verified, scratch.dists);
 
-            if (dist <= tau) {
-                g[j].push_back( { i, dist } );
+            size_t edges_before = local_edges.size();
+            for (size_t k = 0; k < verified.size(); ++k) {
+                if (scratch.dists[k] <= tau) {
+                    local_edges.push_back( { i, base_size + verified[k], static_cast<int>(scratch.dists[k]) } );
+                }
             }
+
+            double query_end = omp_get_wtime();
+            base_progress.add(cand.size(), verified.size(), local_edges.size() - edges_before,
+                              verification_start - query_start, query_end - verification_start);
         }
+
+        busy_time[omp_get_thread_num()] += omp_get_wtime() - start_time;
     }
 
-    num_of_dist_computations = atomic_num_of_dist_computations;
+    size_t new_dist_computations, base_dist_computations;
+    new_progress.merge(new_dist_computations, schedule);
+    base_progress.merge(base_dist_computations, schedule);
+    num_of_dist_computations = new_dist_computations + base_dist_computations;
+
+    double assembly_start = omp_get_wtime();
+    auto graph = CsrGraph::FromEdgeBuffers(base_size + new_reads.size(), buffers, true);
+    if (schedule) {
+        schedule->busy_time = std::move(busy_time);
+        schedule->ordering_time += ordering_time;
+        schedule->assembly_time += omp_get_wtime() - assembly_start;
+    }
+
+    return graph;
+}
+
+
+// Tf is an arbitrary distance functor, it is computed in full for every candidate pair
+template<typename TReads, typename Tf>
+CsrGraph tauDistGraph(const TReads &input_reads,
+                      const KmerIndex &kmer2reads,
+                      const Tf &dist_fun,
+                      unsigned tau,
+                      unsigned K,
+                      unsigned strategy,
+                      size_t &num_of_dist_computations,
+                      ReadRange queries = ReadRange::All(),
+                      QuerySchedule *schedule = nullptr,
+                      const std::vector<size_t> *original_ids = nullptr) {
+    return tauDistGraphBounded(input_reads, kmer2reads, dist_fun, tau, K, strategy, num_of_dist_computations,
+                               queries, schedule, original_ids);
+}
+
+
+// Distance with dist_at_most() interface, evaluation stops as soon as the distance is known to exceed tau.
+// Candidates of a query are verified by batches if reads are packed
+template<typename TReads, typename Tf>
+CsrGraph tauDistGraph(const TReads &input_reads,
+                      const KmerIndex &kmer2reads,
+                      const HalfSWDistance<Tf> &dist,
+                      unsigned tau,
+                      unsigned K,
+                      unsigned strategy,
+                      size_t &num_of_dist_computations,
+                      ReadRange queries = ReadRange::All(),
+                      QuerySchedule *schedule = nullptr,
+                      const std::vector<size_t> *original_ids = nullptr) {
+    BoundedHalfSWDistance<Tf> bounded_dist(dist, tau);
+    return tauDistGraphBounded(input_reads, kmer2reads, bounded_dist, tau, K, strategy, num_of_dist_computations,
+                               queries, schedule, original_ids);
+}
+
+
+template<typename TReads, typename Tf>
+CsrGraph tauMatchGraph(const TReads &input_reads,
+                       const TReads &reference_reads,
+                       const KmerIndex &kmer2reads,
+                       const Tf &dist_fun,
+                       unsigned tau,
+                       unsigned K,
+                       unsigned strategy,
+                       size_t &num_of_dist_computations,
+                       ReadRange queries = ReadRange::All(),
+                      QuerySchedule *schedule = nullptr) {
+    return tauMatchGraphBounded(input_reads, reference_reads, kmer2reads, dist_fun, tau, K, strategy,
+                                num_of_dist_computations, queries, schedule);
+}
+
+
+template<typename TReads, typename Tf>
+CsrGraph tauMatchGraph(const TReads &input_reads,
+                       const TReads &reference_reads,
+                       const KmerIndex &kmer2reads,
+                       const HalfSWDistance<Tf> &dist,
+                       unsigned tau,
+                       unsigned K,
+                       unsigned strategy,
+                       size_t &num_of_dist_computations,
+                       ReadRange queries = ReadRange::All(),
+                      QuerySchedule *schedule = nullptr) {
+    BoundedHalfSWDistance<Tf> bounded_dist(dist, tau);
+    return tauMatchGraphBounded(input_reads, reference_reads, kmer2reads, bounded_dist, tau, K, strategy,
+                                num_of_dist_computations, queries, schedule);
+}
+
 
-    return g;
+template<typename TReads, typename Tf>
+CsrGraph tauIncrementGraph(const TReads &base_reads,
+                           const TReads &new_reads,
+                           const KmerIndex &base_kmer2reads,
+                           const KmerIndex &new_kmer2reads,
+                           const HalfSWDistance<Tf> &dist,
+                           unsigned tau,
+                           unsigned K,
+                           unsigned strategy,
+                           size_t &num_of_dist_computations,
+                           QuerySchedule *schedule = nullptr) {
+    BoundedHalfSWDistance<Tf> bounded_dist(dist, tau);
+    return tauIncrementGraphBounded(base_reads, new_reads, base_kmer2reads, new_kmer2reads, bounded_dist, tau, K,
+                                    strategy, num_of_dist_computations, schedule);
 }
 
 // vim: ts=4:sw=4
@@ -5,6 +5,7 @@
 namespace po = boost::program_options;
 
 #include <iostream>
+#include <sstream>
 using std::cout;
 using std::cin;
 using std::cerr;
@@ -12,16 +13,17 @@ using std::endl;
 
 #include "fast_ig_tools.hpp"
 
-#include <seqan/seq_io.h>
-using seqan::Dna5String;
-using seqan::SeqFileIn;
-using seqan::CharString;
-
 #include "ig_matcher.hpp"
+#include "packed_reads.hpp"
 #include "banded_half_smith_waterman.hpp"
 #include "ig_final_alignment.hpp"
 #include "utils.hpp"
 #include <build_info.hpp>
+#include "csr_graph_io.hpp"
+#include "reference_index.hpp"
+#include "kmer_index_tuning.hpp"
+#include "read_order.hpp"
+#include "../graph_utils/graph_io.hpp"
 
 struct SWGCParam {
     unsigned k = 10;
@@ -29,11 +31,26 @@ struct SWGCParam {
     unsigned nthreads = 4;
     std::string input_file = "";
     std::string output_file = "output.graph";
+    std::string graph_format = "metis";
+    std::string shard = "";
+    std::string base_reads_file = "";
+    std::string base_index_file = "";
+    std::string base_graph_file = "";
+    std::string output_index_file = "";
+    std::string changed_vertices_file = "";
     std::string reference_file = "";
+    std::string reference_index_file = "";
+    bool build_index = false;
     unsigned strategy = 3;
+    std::string query_order = "cost";
+    std::string read_order = "input";
     unsigned max_indels = 0;
     bool export_abundances = false;
     bool ignore_tails = true;
+    bool auto_k = false;
+    size_t auto_k_sample = 2000;
+    double progress_interval = 30;
+    std::string metrics_file = "";
 };
 
 
@@ -52,10 +69,32 @@ bool parse_cmd_line_arguments(int argc, char **argv, SWGCParam &args) {
              "name of an input file (FASTA|FASTQ)")
             ("reference-file,r", po::value<std::string>(&args.reference_file)->default_value(args.reference_file),
              "name of an input file (FASTA|FASTQ)")
+            ("reference-index", po::value<std::string>(&args.reference_index_file)->default_value(args.reference_index_file),
+             "reference reads with their k-mer index written by 'ig_swgraph_construct build-index -r <reference> -o <index>'; "
+             "if -r is given too, the index is checked to be built from it")
             ("output-file,o", po::value<std::string>(&args.output_file),
-             "file for outputted truncated dist-graph in METIS format")
+             "file for outputted truncated dist-graph")
+            ("graph-format", po::value<std::string>(&args.graph_format)->default_value(args.graph_format),
+             "output graph format: metis (text) or binary (memory-mappable CSR, without reference only)")
+            ("shard", po::value<std::string>(&args.shard)->default_value(args.shard),
+             "process only i-th of N parts of input reads given as i/N and write partial edge file "
+             "for ig_swgraph_merge instead of graph")
+            ("output-index", po::value<std::string>(&args.output_index_file)->default_value(args.output_index_file),
+             "file for k-mer index of graph vertices (or of reference reads) to be used as --base-index later")
+            ("base-reads", po::value<std::string>(&args.base_reads_file)->default_value(args.base_reads_file),
+             "incremental mode: reads of existing graph (FASTA|FASTQ), input reads are added to them")
+            ("base-index", po::value<std::string>(&args.base_index_file)->default_value(args.base_index_file),
+             "incremental mode: k-mer index of base reads written by --output-index")
+            ("base-graph", po::value<std::string>(&args.base_graph_file)->default_value(args.base_graph_file),
+             "incremental mode: existing graph on base reads (METIS or binary)")
+            ("changed-vertices", po::value<std::string>(&args.changed_vertices_file)->default_value(args.changed_vertices_file),
+             "incremental mode: file for 0-based indices of vertices whose adjacency has changed, one per line")
             ("export-abundances,A", "export read abundances to output graph file")
             ("no-export-abundances", "don't export read abundances to output graph file (default)")
+            ("auto-k", "choose k and strategy with the lowest expected number of distance computations "
+             "(estimated on a sample of reads) instead of the given ones")
+            ("metrics-file", po::value<std::string>(&args.metrics_file)->default_value(args.metrics_file),
+             "file for JSON metrics of the run: time of stages and counters of graph construction")
             ;
 
     // Declare a group of options that will be
@@ -73,8 +112,17 @@ bool parse_cmd_line_arguments(int argc, char **argv, SWGCParam &args) {
              "maximum distance value for truncated dist-graph construction")
             ("max-indels", po::value<unsigned>(&args.max_indels)->default_value(args.max_indels),
              "maximum number of indels in Levenshtein distance")
+            ("query-order", po::value<std::string>(&args.query_order)->default_value(args.query_order),
+             "order of processing of reads: cost (predicted by candidate counts, the heaviest first) or input")
+            ("read-order", po::value<std::string>(&args.read_order)->default_value(args.read_order),
+             "order of reads in memory during construction: input, minimizer (by the minimal k-mer) or lex; "
+             "similar reads are placed together, output graph does not depend on it")
             ("threads,t", po::value<unsigned>(&args.nthreads)->default_value(args.nthreads),
              "the number of parallel threads")
+            ("auto-k-sample", po::value<size_t>(&args.auto_k_sample)->default_value(args.auto_k_sample),
+             "the number of reads sampled for --auto-k")
+            ("progress-interval", po::value<double>(&args.progress_interval)->default_value(args.progress_interval),
+             "seconds between progress reports during graph construction, 0 disables them")
             ;
 
     // Hidden options, will be allowed both on command line and
@@ -144,16 +192,88 @@ bool parse_cmd_line_arguments(int argc, char **argv, SWGCParam &args) {
         args.export_abundances = false;
     }
 
+    if (vm.count("auto-k")) {
+        args.auto_k = true;
+    }
+
     return true;
 }
 
 
+// Wall-clock time of consecutive stages of the run
+class StageTimer {
+public:
+    void finish(const std::string &stage) {
+        stages_.push_back({ stage, pc_.time() });
+        pc_.reset();
+    }
+
+    const std::vector<std::pair<std::string, double>>& stages() const { return stages_; }
+
+private:
+    perf_counter pc_;
+    std::vector<std::pair<std::string, double>> stages_;
+};
+
+
+void write_metrics(const std::string &filename,
+                   const SWGCParam &args,
+                   const StageTimer &timer,
+                   const QuerySchedule &schedule,
+                   size_t num_of_reads, size_t num_of_queries,
+                   size_t num_of_dist_computations, size_t num_of_edges,
+                   double running_time) {
+    std::ofstream out(filename);
+    VERIFY_MSG(out, "Cannot open " << filename);
+
+    out << "{\n";
+    out << "  \"k\": " << args.k << ",\n";
+    out << "  \"tau\": " << args.tau << ",\n";
+    out << "  \"strategy\": " << args.strategy << ",\n";
+    out << "  \"threads\": " << args.nthreads << ",\n";
+    out << "  \"reads\": " << num_of_reads << ",\n";
+    out << "  \"queries\": " << num_of_queries << ",\n";
+    out << "  \"candidates\": " << schedule.candidates << ",\n";
+    out << "  \"dist_computations\": " << num_of_dist_computations << ",\n";
+    out << "  \"edges\": " << num_of_edges << ",\n";
+
+    // Stages are wall-clock time, candidate generation and verification are summed over threads
+    out << "  \"time\": {\n";
+    for (const auto &stage : timer.stages()) {
+        out << "    \"" << stage.first << "\": " << stage.second << ",\n";
+    }
+    out << "    \"query_ordering\": " << schedule.ordering_time << ",\n";
+    out << "    \"candidate_generation\": " << schedule.candidates_time << ",\n";
+    out << "    \"verification\": " << schedule.verification_time << ",\n";
+    // Assembly of CSR arrays from per-thread edges, edges are mirrored there for undirected graphs
+    out << "    \"undirecting\": " << schedule.assembly_time << ",\n";
+    out << "    \"total\": " << running_time << "\n";
+    out << "  },\n";
+
+    out << "  \"thread_busy_time\": [";
+    for (size_t i = 0; i < schedule.busy_time.size(); ++i) {
+        out << (i ? ", " : "") << schedule.busy_time[i];
+    }
+    out << "]\n";
+    out << "}\n";
+}
+
+
 int main(int argc, char **argv) {
     segfault_handler sh;
     perf_counter pc;
     create_console_logger("");
 
     SWGCParam args;
+
+    // "ig_swgraph_construct build-index -r <reference> -o <index>" only builds the reference index
+    if (argc > 1 && std::string(argv[1]) == "build-index") {
+        args.build_index = true;
+        argv[1] = argv[0];
+        --argc;
+        ++argv;
+    }
+
     try {
         if (!parse_cmd_line_arguments(argc, argv, args)) {
             return 0;
@@ -163,17 +283,90 @@ int main(int argc, char **argv) {
         return 1;
     }
 
+    if (args.graph_format != "metis" && args.graph_format != "binary") {
+        std::cerr << "Unknown graph format " << args.graph_format << ", expected metis or binary" << std::endl;
+        return 1;
+    }
+
+    if (args.query_order != "cost" && args.query_order != "input") {
+        std::cerr << "Unknown query order " << args.query_order << ", expected cost or input" << std::endl;
+        return 1;
+    }
+
+    if (args.read_order != "input" && args.read_order != "minimizer" && args.read_order != "lex") {
+        std::cerr << "Unknown read order " << args.read_order << ", expected input, minimizer or lex" << std::endl;
+        return 1;
+    }
+
+    if (args.build_index) {
+        if (args.reference_file == "") {
+            std::cerr << "build-index requires reference reads (-r)" << std::endl;
+            return 1;
+        }
+
+        INFO("Building reference index of " << args.reference_file << ", k = " << args.k);
+        auto reference_reads = PackedReadStore::read_file(args.reference_file);
+        INFO(reference_reads.size() << " reads were extracted from " << args.reference_file);
+
+        omp_set_num_threads(args.nthreads);
+        ReferenceIndex(std::move(reference_reads), args.k, args.strategy,
+                       file_checksum(args.reference_file)).save(args.output_file);
+        INFO("Reference index was written to " << args.output_file);
+        INFO("Running time: " << running_time_format(pc));
+        return 0;
+    }
+
+    bool undirected = args.reference_file == "" && args.reference_index_file == "";
+
+    if (args.graph_format == "binary" && !undirected) {
+        std::cerr << "Binary graph format supports only undirected graphs (without reference)" << std::endl;
+        return 1;
+    }
+
+    bool incremental = args.base_graph_file != "" || args.base_index_file != "" || args.base_reads_file != "";
+    if (incremental && (args.base_graph_file == "" || args.base_index_file == "" || args.base_reads_file == "")) {
+        std::cerr << "Incremental mode requires all of --base-reads, --base-index and --base-graph" << std::endl;
+        return 1;
+    }
+
+    if (incremental && (!undirected || args.shard != "")) {
+        std::cerr << "Incremental mode is incompatible with reference and shards" << std::endl;
+        return 1;
+    }
+
+    if (args.auto_k && (incremental || !undirected)) {
+        std::cerr << "--auto-k is supported only for graphs without reference and base graph" << std::endl;
+        return 1;
+    }
+
+    // Shards, base graphs and saved indexes refer to reads by their input indices
+    if (args.read_order != "input" &&
+        (incremental || args.shard != "" || (undirected && args.output_index_file != ""))) {
+        std::cerr << "--read-order is incompatible with incremental mode, shards and --output-index" << std::endl;
+        return 1;
+    }
+
+    size_t shard_index = 0, num_shards = 1;
+    if (args.shard != "") {
+        char slash = 0;
+        std::istringstream ss(args.shard);
+        if (!(ss >> shard_index >> slash >> num_shards) || slash != '/' || !ss.eof() || shard_index >= num_shards) {
+            std::cerr << "Wrong shard " << args.shard << ", expected i/N with 0 <= i < N" << std::endl;
+            return 1;
+        }
+    }
+
     INFO("Command line: " << join_cmd_line(argc, argv));
     INFO("Input reads: " << args.input_file);
     INFO("k = " << args.k << ", tau = " << args.tau);
 
-    SeqFileIn seqFileIn_input(args.input_file.c_str());
-    std::vector<CharString> input_ids;
-    std::vector<Dna5String> input_reads;
+    StageTimer timer;
 
     INFO("Reading input reads starts");
-    readRecords(input_ids, input_reads, seqFileIn_input);
+    auto input_reads = PackedReadStore::read_file(args.input_file);
     INFO(input_reads.size() << " reads were extracted from " << args.input_file);
+    INFO("Packed reads occupy " << input_reads.memory_usage() / (1 << 20) << " MiB");
+    timer.finish("reading");
 
     INFO("Read length checking");
     size_t required_read_length = (args.strategy != 0) ? (args.k * (args.tau + args.strategy)) : 0;
@@ -183,10 +376,11 @@ int main(int argc, char **argv) {
     size_t discarded_reads = 0;
     size_t discarded_reads_single = 0;
     size_t discarded_reads_double = 0;
-    for (const auto &read : input_reads) {
-        discarded_reads += length(read) < required_read_length;
-        discarded_reads_single += length(read) < required_read_length_for_single_strategy;
-        discarded_reads_double += length(read) < required_read_length_for_double_strategy;
+    for (size_t j = 0; j < input_reads.size(); ++j) {
+        size_t len = input_reads[j].length();
+        discarded_reads += len < required_read_length;
+        discarded_reads_single += len < required_read_length_for_single_strategy;
+        discarded_reads_double += len < required_read_length_for_double_strategy;
     }
 
     int saved_reads_single = static_cast<int>(discarded_reads) - static_cast<int>(discarded_reads_single);
@@ -206,90 +400,242 @@ int main(int argc, char **argv) {
         }
     }
 
+    omp_set_num_threads(args.nthreads);
+
+    auto tail_cost = [&args](int l) -> size_t { return (!args.ignore_tails && l) ? 2 * args.tau : 0; };
+    auto dist = half_sw_distance(args.max_indels, tail_cost);
+
+    // Never discards more reads than the given k with the strategy chosen above
+    double predicted_dist_computations = 0, predicted_efficiency = 0;
+    if (args.auto_k) {
+        const unsigned min_K = 5, max_K = 64;
+        KmerIndexTuner tuner(input_reads, args.tau, args.auto_k_sample);
+        INFO("Choosing k and strategy on a sample of " << tuner.sample_size() << " reads");
+        auto costs = tuner.rank(min_K, max_K, std::max(args.strategy, 3u), discarded_reads);
+        if (costs.empty()) {
+            WARN("No k in [" << min_K << ", " << max_K << "] keeps the number of discarded reads, k = " << args.k <<
+                 " is used");
+        } else {
+            double given_dist_computations = tuner.predicted_dist_computations(args.k, args.strategy);
+            INFO(bformat("Predicted distance computations %0.0f for k = %d, strategy = %d (given), "
+                         "%0.0f for k = %d, strategy = %d (chosen)")
+                 % given_dist_computations % args.k % args.strategy
+                 % costs[0].dist_computations % costs[0].K % costs[0].strategy);
+            args.k = costs[0].K;
+            args.strategy = costs[0].strategy;
+            discarded_reads = costs[0].discarded_reads;
+            predicted_dist_computations = costs[0].dist_computations;
+            predicted_efficiency = tuner.predicted_efficiency(dist, args.k, args.strategy);
+        }
+        timer.finish("auto_k");
+    }
+
     if (discarded_reads) {
         WARN(bformat("Discarded reads %d") % discarded_reads);
     }
 
-    omp_set_num_threads(args.nthreads);
     INFO(bformat("Truncated distance graph construction using %d threads starts") % args.nthreads);
     INFO("Construction of candidates graph");
 
     INFO("Strategy " << args.strategy << " was chosen");
 
-    auto dist_fun = [&args](const Dna5String& s1, const Dna5String& s2) -> unsigned {
-        auto delta = [&args](int l) -> int { return (bool)(l)*2 * args.tau; };
-        auto lizard_tail = [&args, &delta](int l) -> int { return args.ignore_tails ? 0 : -delta(l); };
-        return -half_sw_banded(s1, s2, 0, -1, -1, lizard_tail, args.max_indels);
-    };
+    ReferenceIndex reference;
+    if (args.reference_index_file != "") {
+        INFO("Loading reference index from " << args.reference_index_file);
+        reference = load_reference_index(args.reference_index_file, args.k, args.strategy, args.reference_file);
+        INFO(reference.reads().size() << " reference reads were loaded");
+    } else if (!undirected) {
+        INFO("Reading reference reads starts");
+        auto reference_reads = PackedReadStore::read_file(args.reference_file);
+        INFO(reference_reads.size() << " reads were extracted from " << args.reference_file);
 
-    if (args.reference_file == "") {
+        INFO("Reference k-mer index construction");
+        reference = ReferenceIndex(std::move(reference_reads), args.k, args.strategy);
+    }
+
+    // Input reads are appended to base reads in incremental mode, base graph and index are taken as is
+    PackedReadStore base_reads;
+    KmerIndex base_kmer2reads;
+    if (incremental) {
+        INFO("Reading base reads starts");
+        base_reads = PackedReadStore::read_file(args.base_reads_file);
+        INFO(base_reads.size() << " reads were extracted from " << args.base_reads_file);
+
+        INFO("Loading k-mer index of base reads from " << args.base_index_file);
+        base_kmer2reads = KmerIndex::load(args.base_index_file);
+        VERIFY_MSG(base_kmer2reads.num_reads() == base_reads.size(),
+                   "K-mer index " << args.base_index_file << " was built on " << base_kmer2reads.num_reads() <<
+                   " reads, but " << base_reads.size() << " base reads were given");
+        VERIFY_MSG(base_kmer2reads.K() == args.k,
+                   "K-mer index " << args.base_index_file << " was built with k = " << base_kmer2reads.K());
+    }
+
+    // Abundances are taken from identifiers before the reads are reordered
+    std::vector<size_t> input_abundances;
+    if (args.export_abundances) {
+        input_abundances = find_abundances(input_reads.ids());
+    }
+
+    std::vector<size_t> original_ids;
+    if (args.read_order != "input") {
+        INFO("Reordering reads (" << args.read_order << " order)");
+        original_ids = (args.read_order == "minimizer") ? minimizer_order(input_reads, args.k)
+                                                        : lexicographic_order(input_reads);
+        input_reads = input_reads.select(original_ids);
+    }
+
+    KmerIndex kmer2reads;
+    if (undirected) {
         INFO("K-mer index construction");
-        auto kmer2reads = kmerIndexConstruction(input_reads, args.k);
+        kmer2reads = kmerIndexConstruction(input_reads, args.k);
+    }
+
+    if (args.output_index_file != "") {
+        INFO("Saving k-mer index to " << args.output_index_file);
+        if (incremental) {
+            KmerIndex::merge(base_kmer2reads, kmer2reads).save(args.output_index_file);
+        } else {
+            (undirected ? kmer2reads : reference.kmer_index()).save(args.output_index_file);
+        }
+    }
+
+    timer.finish("index_build");
+
+    ReadRange queries = ReadRange::Shard(input_reads.size(), shard_index, num_shards);
+    if (args.shard != "") {
+        INFO("Shard " << args.shard << ": queries [" << queries.begin << ", " << queries.end << ")");
+    }
+
+    QuerySchedule schedule;
+    schedule.by_cost = args.query_order == "cost";
+    schedule.progress_interval = args.progress_interval;
 
-        size_t num_of_dist_computations;
-        auto dist_graph = tauDistGraph(input_reads,
+    size_t num_of_dist_computations;
+    CsrGraph dist_graph;
+    if (incremental) {
+        dist_graph = tauIncrementGraph(base_reads,
+                                       input_reads,
+                                       base_kmer2reads,
                                        kmer2reads,
-                                       dist_fun,
+                                       dist,
                                        args.tau, args.k,
                                        args.strategy,
-                                       num_of_dist_computations);
+                                       num_of_dist_computations,
+                                       &schedule);
+    } else if (undirected) {
+        dist_graph = tauDistGraph(input_reads,
+                                  kmer2reads,
+                                  dist,
+                                  args.tau, args.k,
+                                  args.strategy,
+                                  num_of_dist_computations,
+                                  queries, &schedule,
+                                  original_ids.empty() ? nullptr : &original_ids);
+    } else {
+        dist_graph = tauMatchGraph(input_reads,
+                                   reference.reads(),
+                                   reference.kmer_index(),
+                                   dist,
+                                   args.tau, args.k,
+                                   args.strategy,
+                                   num_of_dist_computations,
+                                   queries, &schedule);
+    }
 
-        INFO("Simularity computations: " << num_of_dist_computations << ", average " << \
-             static_cast<double>(num_of_dist_computations) / input_reads.size() << " per read");
+    timer.finish("graph_construction");
 
-        size_t num_of_edges = numEdges(dist_graph);
-        INFO("Edges found: " << num_of_edges);
-        INFO("Strategy efficiency: " << static_cast<double> (num_of_edges) / num_of_dist_computations);
+    INFO("Simularity computations: " << num_of_dist_computations << ", average " << \
+         static_cast<double>(num_of_dist_computations) / (queries.end - queries.begin) << " per read");
 
-        // Output
-        if (args.export_abundances) {
-            INFO("Saving graph (with abundances)");
-            auto abundances = find_abundances(input_ids);
-            write_metis_graph(dist_graph, abundances, args.output_file);
-        } else {
-            INFO("Saving graph (without abundances)");
-            write_metis_graph(dist_graph, args.output_file);
+    if (!schedule.busy_time.empty()) {
+        const auto &busy_time = schedule.busy_time;
+        double max_time = *std::max_element(busy_time.cbegin(), busy_time.cend());
+        double mean_time = std::accumulate(busy_time.cbegin(), busy_time.cend(), 0.) / busy_time.size();
+        INFO(bformat("Thread busy time: min %0.3fs, mean %0.3fs, max %0.3fs, imbalance (max / mean) %0.3f")
+             % *std::min_element(busy_time.cbegin(), busy_time.cend()) % mean_time % max_time
+             % (mean_time > 0 ? max_time / mean_time : 1.));
+    }
+
+    if (!original_ids.empty()) {
+        dist_graph = renumber_vertices(dist_graph, original_ids, undirected);
+    }
+
+    size_t num_of_edges = numEdges(dist_graph, undirected);
+    INFO("Edges found: " << num_of_edges);
+    INFO("Strategy efficiency: " << static_cast<double> (num_of_edges) / num_of_dist_computations);
+    if (predicted_dist_computations > 0) {
+        double fraction = static_cast<double>(queries.end - queries.begin) / input_reads.size();
+        INFO(bformat("Distance computations: predicted %0.0f, actual %d; efficiency: predicted %0.3f, actual %0.3f")
+             % (predicted_dist_computations * fraction) % num_of_dist_computations
+             % predicted_efficiency % (static_cast<double>(num_of_edges) / num_of_dist_computations));
+    }
+
+    std::vector<size_t> base_weights;
+    if (incremental) {
+        INFO("Loading base graph from " << args.base_graph_file);
+        GraphReader base_graph_reader(args.base_graph_file);
+        SparseGraphPtr base_graph = base_graph_reader.CreateGraph();
+        VERIFY_MSG(base_graph && base_graph->N() == base_reads.size(),
+                   "Graph " << args.base_graph_file << " does not match " << base_reads.size() << " base reads");
+        // Abundances of base reads are the weights of base graph vertices
+        VERIFY_MSG(!args.export_abundances || base_graph_reader.VertexWeighted(),
+                   "Graph " << args.base_graph_file << " has no abundances, but -A was given");
+
+        if (args.changed_vertices_file != "") {
+            std::ofstream out(args.changed_vertices_file);
+            for (size_t v = 0; v < dist_graph.size(); ++v) {
+                if (v >= base_reads.size() || !dist_graph[v].empty()) {
+                    out << v << "\n";
+                }
+            }
+            INFO("Changed vertices were written to " << args.changed_vertices_file);
         }
-    } else {
-        SeqFileIn seqFileIn_reference(args.reference_file.c_str());
-        std::vector<CharString> reference_ids;
-        std::vector<Dna5String> reference_reads;
 
-        INFO("Reading input reads starts");
-        readRecords(reference_ids, reference_reads, seqFileIn_reference);
-        INFO(reference_reads.size() << " reads were extracted from " << args.reference_file);
+        dist_graph = add_edges(*base_graph, dist_graph);
+        base_weights.assign(base_graph->Weight().begin(), base_graph->Weight().end());
+        INFO("Edges in updated graph: " << numEdges(dist_graph, undirected));
+    }
 
-        INFO("K-mer index construction");
-        auto kmer2reads = kmerIndexConstruction(reference_reads, args.k);
-
-        size_t num_of_dist_computations;
-        auto dist_graph = tauMatchGraph(input_reads,
-                                        reference_reads,
-                                        kmer2reads,
-                                        dist_fun,
-                                        args.tau, args.k,
-                                        args.strategy,
-                                        num_of_dist_computations);
-
-        INFO("Simularity computations: " << num_of_dist_computations << ", average " << \
-             static_cast<double>(num_of_dist_computations) / input_reads.size() << " per read");
-
-        size_t num_of_edges = numEdges(dist_graph, false);
-        INFO("Edges found: " << num_of_edges);
-        INFO("Strategy efficiency: " << static_cast<double> (num_of_edges) / num_of_dist_computations);
-
-        // Output
-        if (args.export_abundances) {
-            INFO("Saving graph (with abundances)");
-            auto abundances = find_abundances(input_ids);
-            write_metis_graph(dist_graph, abundances, args.output_file, false);
-        } else {
-            INFO("Saving graph (without abundances)");
-            write_metis_graph(dist_graph, args.output_file, false);
+    // Vertices are base reads (if any) followed by input reads
+    auto vertex_abundances = [&]() {
+        std::vector<size_t> abundances = base_weights;
+        for (size_t abundance : input_abundances) {
+            abundances.push_back(abundance);
         }
+        return abundances;
+    };
+
+    timer.finish("post_processing");
+
+    // Output
+    if (args.shard != "") {
+        INFO("Saving graph shard (" << (args.export_abundances ? "with" : "without") << " abundances)");
+        write_graph_shard(args.output_file, dist_graph, queries.begin, queries.end,
+                          undirected ? input_reads.size() : reference.reads().size(), undirected,
+                          args.export_abundances ? &input_abundances : nullptr);
+    } else if (args.graph_format == "binary") {
+        INFO("Saving graph in binary format (" << (args.export_abundances ? "with" : "without") << " abundances)");
+        auto weights = args.export_abundances ? vertex_abundances() : std::vector<size_t>(dist_graph.size(), 1);
+        auto sparse_graph = to_sparse_graph(dist_graph, std::move(weights));
+        dist_graph = CsrGraph(); // Free memory
+        GraphWriter(args.output_file).PrintBinaryGraph(sparse_graph, args.export_abundances);
+    } else if (args.export_abundances) {
+        INFO("Saving graph (with abundances)");
+        auto abundances = vertex_abundances();
+        write_metis_graph(dist_graph, abundances, args.output_file, undirected);
+    } else {
+        INFO("Saving graph (without abundances)");
+        write_metis_graph(dist_graph, args.output_file, undirected);
     }
 
-    INFO("Graph was written to " << args.output_file);
+    INFO((args.shard != "" ? "Graph shard" : "Graph") << " was written to " << args.output_file);
+    timer.finish("writing");
+
+    if (args.metrics_file != "") {
+        write_metrics(args.metrics_file, args, timer, schedule, input_reads.size(), queries.end - queries.begin,
+                      num_of_dist_computations, num_of_edges, pc.time());
+        INFO("Metrics were written to " << args.metrics_file);
+    }
 
     INFO("Running time: " << running_time_format(pc));
 
@@ -0,0 +1,118 @@
+#include <boost/program_options.hpp>
+namespace po = boost::program_options;
+
+#include <iostream>
+using std::cout;
+
+#include "fast_ig_tools.hpp"
+#include "csr_graph_io.hpp"
+#include "utils.hpp"
+#include "../graph_utils/graph_io.hpp"
+#include <build_info.hpp>
+
+struct SWGMParam {
+    std::vector<std::string> shard_files;
+    std::string output_file = "output.graph";
+    std::string graph_format = "metis";
+};
+
+
+bool parse_cmd_line_arguments(int argc, char **argv, SWGMParam &args) {
+    po::options_description generic("Generic options");
+    generic.add_options()
+            ("version,v", "print version string")
+            ("help,h", "produce help message")
+            ("shard-files,i", po::value<std::vector<std::string>>(&args.shard_files)->multitoken(),
+             "graph shards written by ig_swgraph_construct --shard, in any order")
+            ("output-file,o", po::value<std::string>(&args.output_file)->default_value(args.output_file),
+             "file for outputted truncated dist-graph")
+            ("graph-format", po::value<std::string>(&args.graph_format)->default_value(args.graph_format),
+             "output graph format: metis (text) or binary (memory-mappable CSR, undirected graphs only)")
+            ;
+
+    po::positional_options_description p;
+    p.add("shard-files", -1);
+
+    po::variables_map vm;
+    store(po::command_line_parser(argc, argv).
+          options(generic).positional(p).run(), vm);
+
+    if (vm.count("help")) {
+        cout << generic << std::endl;
+        return false;
+    }
+
+    if (vm.count("version")) {
+        cout << bformat("S-W Graph Shards Merger, part of IgReC version %s; git version: %s") % build_info::version % build_info::git_hash7 << std::endl;
+        return false;
+    }
+
+    try {
+        notify(vm);
+    } catch (po::error &e) {
+        cout << "Parser error: " << e.what() << std::endl;
+    }
+
+    return true;
+}
+
+
+int main(int argc, char **argv) {
+    segfault_handler sh;
+    perf_counter pc;
+    create_console_logger("");
+
+    SWGMParam args;
+    try {
+        if (!parse_cmd_line_arguments(argc, argv, args)) {
+            return 0;
+        }
+    } catch(std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    if (args.graph_format != "metis" && args.graph_format != "binary") {
+        std::cerr << "Unknown graph format " << args.graph_format << ", expected metis or binary" << std::endl;
+        return 1;
+    }
+
+    if (args.shard_files.empty()) {
+        std::cerr << "No graph shards were given" << std::endl;
+        return 1;
+    }
+
+    INFO("Command line: " << join_cmd_line(argc, argv));
+    INFO("Merging " << args.shard_files.size() << " graph shards");
+
+    bool undirected;
+    std::vector<size_t> abundances;
+    CsrGraph graph = merge_graph_shards(args.shard_files, undirected, abundances);
+    bool export_abundances = !abundances.empty();
+    INFO("Vertices: " << graph.size() << ", edges: " << numEdges(graph, undirected));
+
+    if (args.graph_format == "binary") {
+        VERIFY_MSG(undirected, "Binary graph format supports only undirected graphs (without reference)");
+        INFO("Saving graph in binary format (" << (export_abundances ? "with" : "without") << " abundances)");
+        if (!export_abundances) {
+            abundances.assign(graph.size(), 1);
+        }
+        auto sparse_graph = to_sparse_graph(graph, std::move(abundances));
+        graph = CsrGraph(); // Free memory
+        GraphWriter(args.output_file).PrintBinaryGraph(sparse_graph, export_abundances);
+    } else if (export_abundances) {
+        INFO("Saving graph (with abundances)");
+        write_metis_graph(graph, abundances, args.output_file, undirected);
+    } else {
+        INFO("Saving graph (without abundances)");
+        write_metis_graph(graph, args.output_file, undirected);
+    }
+
+    INFO("Graph was written to " << args.output_file);
+
+    INFO("Running time: " << running_time_format(pc));
+
+    return 0;
+}
+
+// vim: ts=4:sw=4
@@ -14,6 +14,7 @@ namespace po = boost::program_options;
 
 #include "fast_ig_tools.hpp"
 #include "ig_trie_compressor.hpp"
+#include "external_compressor.hpp"
 #include "utils.hpp"
 
 using fast_ig_tools::Compressor;
@@ -25,6 +26,48 @@ using seqan::SeqFileOut;
 using seqan::CharString;
 using seqan::length;
 
+typedef std::pair<const CharString&, const Dna5String&> Record;
+
+// Writes every read i with indices[i] == i, its id is appended with its abundance, and the map from input reads
+// to written ones. record(i) is called for all input reads in order. Abundances are replaced by new indices
+// of reads as soon as they are written, so that no other per-read vector is kept
+template<typename Tf>
+void write_compressed_reads(const std::vector<size_t> &indices,
+                            Tf record,
+                            const std::string &output_file,
+                            const std::string &idmap_file_name) {
+    std::vector<size_t> abundances(indices.size());
+    for (size_t i : indices) {
+        abundances[i] += 1;  // TODO parse input read abundances and add their values here
+    }
+
+    SeqFileOut seqFileOut_output(output_file.c_str());
+    size_t count = 0;
+    for (size_t i = 0; i < indices.size(); ++i) {
+        Record input = record(i);
+        if (indices[i] == i) {
+            std::string id = seqan::toCString(input.first);
+            id += "___size___" + std::to_string(abundances[i]);
+
+            seqan::writeRecord(seqFileOut_output, id, input.second);
+            abundances[i] = count;
+            ++count;
+        }
+    }
+
+    INFO(count << " compressed reads were written to " << output_file);
+
+    if (idmap_file_name != "") {
+        std::ofstream idmap_file(idmap_file_name.c_str());
+
+        for (size_t i : indices) {
+            idmap_file << abundances[i] << "\n";
+        }
+
+        INFO("Map from input reads to compressed reads was written to " << idmap_file_name);
+    }
+}
+
 int main(int argc, char **argv) {
     segfault_handler sh;
     perf_counter pc;
@@ -34,6 +77,10 @@ int main(int argc, char **argv) {
     std::string output_file = "output.fa";
     std::string idmap_file_name = "";
     bool ignore_tails = true;
+    unsigned nthreads = 4;
+    std::string trie = "radix";
+    size_t memory_limit = 0;
+    std::string tmp_dir = "";
     try {
         // Declare a group of options that will be
         // allowed only on command line
@@ -57,6 +104,14 @@ int main(int argc, char **argv) {
         config.add_options()
             ("ignore-tails,T", po::value<bool>(&ignore_tails)->default_value(ignore_tails),
              "wheather to ignore extra tail of the longest read during read comparison")
+            ("threads,t", po::value<unsigned>(&nthreads)->default_value(nthreads),
+             "the number of parallel threads; pointer trie is built by partitions of first bases if > 1")
+            ("trie", po::value<std::string>(&trie)->default_value(trie),
+             "trie type: radix (compact, reads sorted over packed letters) or pointer (node per letter)")
+            ("memory-limit", po::value<size_t>(&memory_limit)->default_value(memory_limit),
+             "memory for reads in MB; reads are streamed and sorted externally if > 0, loaded at once if 0")
+            ("tmp-dir", po::value<std::string>(&tmp_dir)->default_value(tmp_dir),
+             "directory of temporary files of external sort; empty (default) for the output file directory")
             ;
 
         // Hidden options, will be allowed both on command line and
@@ -123,12 +178,39 @@ int main(int argc, char **argv) {
         return 1;
     }
 
+    if (trie != "radix" && trie != "pointer") {
+        std::cerr << "Unknown trie type " << trie << ", expected radix or pointer" << std::endl;
+        return 1;
+    }
+
     INFO("Command line: " << join_cmd_line(argc, argv));
     INFO("Input reads: " << input_file);
     INFO("Output filename: " << output_file);
 
+    if (memory_limit > 0) {
+        std::string tmp_prefix = output_file;
+        if (tmp_dir != "") {
+            tmp_prefix = tmp_dir + "/" + output_file.substr(output_file.rfind('/') + 1);
+        }
+
+        INFO("Compression of reads starts, memory limit " << memory_limit << " MB");
+        auto indices = fast_ig_tools::external_compressed_reads_indices(input_file, ignore_tails,
+                                                                        memory_limit << 20, tmp_prefix);
+        INFO("Compression of " << indices.size() << " reads finished");
+
+        SeqFileIn seqFileIn_input(input_file.c_str());
+        CharString input_id;
+        Dna5String input_read;
+        write_compressed_reads(indices, [&](size_t) {
+                                   readRecord(input_id, input_read, seqFileIn_input);
+                                   return Record(input_id, input_read);
+                               },
+                               output_file, idmap_file_name);
+        INFO("Running time: " << running_time_format(pc));
+        return 0;
+    }
+
     SeqFileIn seqFileIn_input(input_file.c_str());
-    SeqFileOut seqFileOut_output(output_file.c_str());
     std::vector<CharString> input_ids;
     std::vector<Dna5String> input_reads;
 
@@ -137,43 +219,15 @@ int main(int argc, char **argv) {
     INFO(length(input_reads) << " reads were extracted from " << input_file);
 
     INFO("Compression of reads starts");
+    omp_set_num_threads(nthreads);
+    auto trie_type = (trie == "radix") ? Compressor::Type::RadixTrieCompressor :
+                     (nthreads > 1) ? Compressor::Type::PartitionedTrieCompressor : Compressor::Type::TrieCompressor;
     auto indices = Compressor::compressed_reads_indices(input_reads,
-                                                        ignore_tails ? Compressor::Type::TrieCompressor : Compressor::Type::HashCompressor);
+                                                        ignore_tails ? trie_type : Compressor::Type::FingerprintHashCompressor);
     INFO("Compression of reads finished")
 
-    std::vector<size_t> abundances(indices.size());
-    std::vector<size_t> index2newindex(indices.size());
-
-    size_t count = 0;
-    for (size_t i = 0; i < indices.size(); ++i) {
-        if (indices[i] == i) {
-            index2newindex[i] = count;
-            ++count;
-        }
-
-        abundances[indices[i]] += 1;  // TODO parse input read abundances and add their values here
-    }
-
-    for (size_t i = 0; i < indices.size(); ++i) {
-        if (indices[i] == i) {
-            std::string id = seqan::toCString(input_ids[i]);
-            id += "___size___" + std::to_string(abundances[i]);
-
-            seqan::writeRecord(seqFileOut_output, id, input_reads[i]);
-        }
-    }
-
-    INFO(count << " compressed reads were written to " << output_file);
-
-    if (idmap_file_name != "") {
-        std::ofstream idmap_file(idmap_file_name.c_str());
-
-        for (size_t i : indices) {
-            idmap_file << index2newindex[i] << "\n";
-        }
-
-        INFO("Map from input reads to compressed reads was written to " << idmap_file_name);
-    }
+    write_compressed_reads(indices, [&](size_t i) { return Record(input_ids[i], input_reads[i]); },
+                           output_file, idmap_file_name);
     INFO("Running time: " << running_time_format(pc));
     return 0;
 }
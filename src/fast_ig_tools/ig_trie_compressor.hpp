@@ -2,14 +2,19 @@
 
 #include <algorithm>
 #include <array>
+#include <atomic>
 #include <boost/pool/object_pool.hpp>
 #include <cassert>
+#include <cstdint>
+#include <numeric>
 #include <limits>
 #include <memory>
 #include <boost/unordered_map.hpp>
 #include <vector>
 
 #include <seqan/seq_io.h>
+#include <openmp_wrapper.h>
+#include <parallel_wrapper.hpp>
 
 namespace fast_ig_tools {
 template <typename T>
@@ -20,7 +25,7 @@ using ValueType = Decay<decltype(Decay<TArray>()[0])>;
 
 class Compressor {
 public:
-    enum class Type {HashCompressor, TrieCompressor};
+    enum class Type {HashCompressor, TrieCompressor, PartitionedTrieCompressor, RadixTrieCompressor, FingerprintHashCompressor};
     virtual std::vector<size_t> checkout() = 0;
     virtual ~Compressor() = default;
 
@@ -171,6 +176,27 @@ public:
         return compressed_;
     }
 
+    // Index of the representative of the shortest added read that is a prefix of s, size() if there is none
+    template <typename T>
+    size_t prefix_representative(const T &s) const {
+        const TrieNode *p = root_;
+        for (size_t i = 0; ; ++i) {
+            if (p->ids) {
+                return p->ids->represent();
+            }
+            if (i == seqan::length(s)) {
+                break;
+            }
+
+            p = p->children[seqan::ordValue(s[i])];
+            if (!p) {
+                break;
+            }
+        }
+
+        return size();
+    }
+
     void compress() {
         if (!isCompressed()) {
             root_->compress_to_prefix();
@@ -280,6 +306,403 @@ private:
 };
 
 
+// The same compression as TrieCompressor, in parallel. Reads are partitioned by their first prefix_length letters,
+// so that a read of at least prefix_length letters can be a prefix only of reads of its own partition, and sub-tries
+// of partitions are built and checked out independently. Shorter reads go to a separate trie; the shortest of them
+// that is a prefix of the partition key joins the whole partition, exactly as it does in a single trie
+template <typename TValue = seqan::Dna5>
+class PartitionedTrieCompressor : public Compressor {
+public:
+    virtual ~PartitionedTrieCompressor() = default;
+
+    template <typename TCont>
+    PartitionedTrieCompressor(const TCont &cont, size_t prefix_length = 0) :
+            PartitionedTrieCompressor(cont.cbegin(), cont.cend(), prefix_length) { }
+
+    // TIter is a random access iterator. Zero prefix_length means as many letters as give at most 4096 partitions
+    template <typename TIter>
+    PartitionedTrieCompressor(TIter b, TIter e, size_t prefix_length = 0) {
+        const size_t n = e - b;
+        if (!prefix_length) {
+            for (size_t partitions = card; partitions <= max_partitions; partitions *= card) {
+                ++prefix_length;
+            }
+            prefix_length = std::max<size_t>(prefix_length, 1);
+        }
+
+        size_t num_partitions = 1;
+        for (size_t i = 0; i < prefix_length; ++i) {
+            num_partitions *= card;
+        }
+
+        // Reads shorter than prefix_length get key num_partitions
+        std::vector<size_t> keys(n);
+        SEQAN_OMP_PRAGMA(parallel for schedule(static))
+        for (size_t j = 0; j < n; ++j) {
+            const auto &read = b[j];
+            size_t key = num_partitions;
+            if (seqan::length(read) >= prefix_length) {
+                key = 0;
+                for (size_t i = 0; i < prefix_length; ++i) {
+                    key = key * card + seqan::ordValue(read[i]);
+                }
+            }
+            keys[j] = key;
+        }
+
+        // Stable counting sort of reads by keys, every partition is in input order
+        std::vector<size_t> offsets(num_partitions + 2, 0);
+        for (size_t key : keys) {
+            ++offsets[key + 1];
+        }
+        for (size_t key = 0; key <= num_partitions; ++key) {
+            offsets[key + 1] += offsets[key];
+        }
+        std::vector<size_t> order(n);
+        {
+            std::vector<size_t> positions(offsets.cbegin(), offsets.cend() - 1);
+            for (size_t j = 0; j < n; ++j) {
+                order[positions[keys[j]]++] = j;
+            }
+        }
+
+        result_.resize(n);
+
+        // Short reads can be prefixes only of each other
+        TrieCompressor<TValue> short_reads;
+        for (size_t k = offsets[num_partitions]; k < n; ++k) {
+            short_reads.add(b[order[k]]);
+        }
+        const size_t *short_ids = order.data() + offsets[num_partitions];
+        auto short_indices = short_reads.checkout();
+        for (size_t k = 0; k < short_indices.size(); ++k) {
+            result_[short_ids[k]] = short_ids[short_indices[k]];
+        }
+
+        SEQAN_OMP_PRAGMA(parallel for schedule(dynamic, 1))
+        for (size_t key = 0; key < num_partitions; ++key) {
+            const size_t *ids = order.data() + offsets[key];
+            size_t size = offsets[key + 1] - offsets[key];
+            if (!size) {
+                continue;
+            }
+
+            // Reads of the partition share their first prefix_length letters, and so their shortest short prefix
+            size_t short_target = short_reads.prefix_representative(b[ids[0]]);
+            if (short_target != short_reads.size()) {
+                for (size_t k = 0; k < size; ++k) {
+                    result_[ids[k]] = short_ids[short_target];
+                }
+                continue;
+            }
+
+            TrieCompressor<TValue> trie;
+            for (size_t k = 0; k < size; ++k) {
+                trie.add(b[ids[k]]);
+            }
+            auto indices = trie.checkout();
+            for (size_t k = 0; k < size; ++k) {
+                result_[ids[k]] = ids[indices[k]];
+            }
+        }
+    }
+
+    size_t size() const {
+        return result_.size();
+    }
+
+    virtual std::vector<size_t> checkout() {
+        return result_;
+    }
+
+private:
+    static constexpr size_t card = seqan::ValueSize<TValue>::VALUE;
+    static constexpr size_t max_partitions = 4096;
+
+    std::vector<size_t> result_;
+};
+
+
+// Reads packed by bits of an alphabet letter each. Letters of a read start at a word boundary,
+// the rest of its last word is zero, so that reads can be compared word by word
+template <typename TValue = seqan::Dna5>
+class PackedReads {
+public:
+    PackedReads() = default;
+
+    size_t size() const {
+        return lengths_.size();
+    }
+
+    size_t length(size_t j) const {
+        return lengths_[j];
+    }
+
+    template <typename T>
+    void add(const T &s) {
+        size_t len = seqan::length(s);
+        offsets_.push_back(words_.size());
+        lengths_.push_back(len);
+        words_.resize(words_.size() + num_words(len), 0);
+        pack(s, words_.data() + offsets_.back());
+    }
+
+    // TIter is a random access iterator; reads are packed in parallel
+    template <typename TIter>
+    void add(TIter b, TIter e) {
+        const size_t first = size();
+        const size_t n = e - b;
+        size_t num_words_total = words_.size();
+        offsets_.reserve(first + n);
+        lengths_.reserve(first + n);
+        for (size_t j = 0; j < n; ++j) {
+            size_t len = seqan::length(b[j]);
+            offsets_.push_back(num_words_total);
+            lengths_.push_back(len);
+            num_words_total += num_words(len);
+        }
+        words_.resize(num_words_total, 0);
+
+        SEQAN_OMP_PRAGMA(parallel for schedule(static))
+        for (size_t j = 0; j < n; ++j) {
+            pack(b[j], words_.data() + offsets_[first + j]);
+        }
+    }
+
+    const uint64_t *words(size_t j) const {
+        return words_.data() + offsets_[j];
+    }
+
+    size_t letter(size_t j, size_t i) const {
+        uint64_t word = words(j)[i / letters_per_word];
+        return (word >> (bits_per_letter * (i % letters_per_word))) & ((uint64_t(1) << bits_per_letter) - 1);
+    }
+
+    // Common prefix of reads j1 and j2 up to the shorter one, word by word
+    size_t common_prefix_length(size_t j1, size_t j2) const {
+        size_t len = std::min(lengths_[j1], lengths_[j2]);
+        const uint64_t *words1 = words(j1);
+        const uint64_t *words2 = words(j2);
+        for (size_t w = 0; w < num_words(len); ++w) {
+            uint64_t diff = words1[w] ^ words2[w];
+            if (diff) {
+                size_t i = w * letters_per_word + __builtin_ctzll(diff) / bits_per_letter;
+                return std::min(i, len);
+            }
+        }
+
+        return len;
+    }
+
+    bool is_prefix(size_t j1, size_t j2) const {
+        return lengths_[j1] <= lengths_[j2] && common_prefix_length(j1, j2) == lengths_[j1];
+    }
+
+    bool equal(size_t j1, size_t j2) const {
+        return lengths_[j1] == lengths_[j2] && std::equal(words(j1), words(j1) + num_words(lengths_[j1]), words(j2));
+    }
+
+    static size_t num_words(size_t len) {
+        return (len + letters_per_word - 1) / letters_per_word;
+    }
+
+private:
+    static constexpr size_t card = seqan::ValueSize<TValue>::VALUE;
+
+    static constexpr size_t bits(size_t n) {
+        return n ? 1 + bits(n >> 1) : 0;
+    }
+
+    static constexpr size_t bits_per_letter = bits(card - 1);
+    static constexpr size_t letters_per_word = 64 / bits_per_letter;
+
+    std::vector<uint64_t> words_;
+    std::vector<size_t> offsets_;
+    std::vector<size_t> lengths_;
+
+    template <typename T>
+    static void pack(const T &s, uint64_t *words) {
+        for (size_t i = 0; i < seqan::length(s); ++i) {
+            uint64_t letter = seqan::ordValue(s[i]);
+            words[i / letters_per_word] |= letter << (bits_per_letter * (i % letters_per_word));
+        }
+    }
+};
+
+
+// The same compression as TrieCompressor with a path-compressed (radix) trie kept implicitly. Preorder of the radix
+// trie of reads is their lexicographic order (a proper prefix first), so a subtree is a range of the sorted array
+// of read indices, an edge label is a common prefix of packed reads, and reads ending at a node (equal reads)
+// are a range at the head of its subtree. Neither nodes nor child lists are allocated: memory is packed letters
+// (bits of an alphabet letter each) and three words per read instead of a node per letter of every distinct prefix
+template <typename TValue = seqan::Dna5>
+class RadixTrieCompressor : public Compressor {
+public:
+    RadixTrieCompressor() = default;
+    virtual ~RadixTrieCompressor() = default;
+
+    template <typename TCont>
+    RadixTrieCompressor(const TCont &cont) : RadixTrieCompressor(cont.cbegin(), cont.cend()) { }
+
+    // TIter is a random access iterator
+    template <typename TIter>
+    RadixTrieCompressor(TIter b, TIter e) : RadixTrieCompressor() {
+        reads_.add(b, e);
+    }
+
+    size_t size() const {
+        return reads_.size();
+    }
+
+    template <typename T>
+    void add(const T &s) {
+        reads_.add(s);
+    }
+
+    virtual std::vector<size_t> checkout() {
+        std::vector<size_t> order(size());
+        std::iota(order.begin(), order.end(), 0);
+        parallel::sort(order.begin(), order.end(),
+                       [this](size_t j1, size_t j2) -> bool { return less(j1, j2); });
+
+        // The shortest read that is a prefix of the current one is the root of its subtree.
+        // Equal reads are ordered by index, so the root is the first of them
+        std::vector<size_t> result(size());
+        size_t root = size();
+        for (size_t j : order) {
+            if (root != size() && reads_.is_prefix(root, j)) {
+                result[j] = root;
+            } else {
+                root = j;
+                result[j] = j;
+            }
+        }
+
+        return result;
+    }
+
+private:
+    PackedReads<TValue> reads_;
+
+    // Lexicographic order, a proper prefix first, equal reads by index
+    bool less(size_t j1, size_t j2) const {
+        size_t len1 = reads_.length(j1), len2 = reads_.length(j2);
+        size_t common = reads_.common_prefix_length(j1, j2);
+        if (common < std::min(len1, len2)) {
+            return reads_.letter(j1, common) < reads_.letter(j2, common);
+        }
+
+        return len1 < len2 || (len1 == len2 && j1 < j2);
+    }
+};
+
+
+// The same compression as HashCompressor without a string key per read. Reads are packed, keyed by 128-bit
+// fingerprints of their words and inserted into an open-addressing table of read indices (twice as many slots
+// as reads) in parallel. Reads are compared in full only if fingerprints coincide, and a slot of equal reads
+// keeps the least of their indices, so the result does not depend on the order of insertion
+template <typename TValue = seqan::Dna5>
+class FingerprintHashCompressor : public Compressor {
+public:
+    FingerprintHashCompressor() = default;
+    virtual ~FingerprintHashCompressor() = default;
+
+    template <typename TCont>
+    FingerprintHashCompressor(const TCont &cont) : FingerprintHashCompressor(cont.cbegin(), cont.cend()) { }
+
+    // TIter is a random access iterator
+    template <typename TIter>
+    FingerprintHashCompressor(TIter b, TIter e) : FingerprintHashCompressor() {
+        reads_.add(b, e);
+    }
+
+    size_t size() const {
+        return reads_.size();
+    }
+
+    template <typename T>
+    void add(const T &s) {
+        reads_.add(s);
+    }
+
+    virtual std::vector<size_t> checkout() {
+        const size_t n = size();
+        std::vector<Fingerprint> fingerprints(n);
+        SEQAN_OMP_PRAGMA(parallel for schedule(static))
+        for (size_t j = 0; j < n; ++j) {
+            fingerprints[j] = fingerprint(j);
+        }
+
+        size_t capacity = 16;
+        while (capacity < 2 * n) {
+            capacity *= 2;
+        }
+        const size_t mask = capacity - 1;
+        std::unique_ptr<std::atomic<size_t>[]> table(new std::atomic<size_t>[capacity]);
+        for (size_t slot = 0; slot < capacity; ++slot) {
+            table[slot].store(n, std::memory_order_relaxed);
+        }
+
+        auto same = [&](size_t j1, size_t j2) -> bool {
+            return fingerprints[j1] == fingerprints[j2] && reads_.equal(j1, j2);
+        };
+
+        SEQAN_OMP_PRAGMA(parallel for schedule(static))
+        for (size_t j = 0; j < n; ++j) {
+            for (size_t slot = fingerprints[j].first & mask; ; slot = (slot + 1) & mask) {
+                size_t current = table[slot].load(std::memory_order_relaxed);
+                if (current == n && table[slot].compare_exchange_strong(current, j)) {
+                    break;
+                }
+                if (current != n && same(j, current)) {
+                    while (j < current && !table[slot].compare_exchange_weak(current, j)) { }
+                    break;
+                }
+            }
+        }
+
+        std::vector<size_t> result(n);
+        SEQAN_OMP_PRAGMA(parallel for schedule(static))
+        for (size_t j = 0; j < n; ++j) {
+            size_t slot = fingerprints[j].first & mask;
+            while (!same(j, table[slot].load(std::memory_order_relaxed))) {
+                slot = (slot + 1) & mask;
+            }
+            result[j] = table[slot].load(std::memory_order_relaxed);
+        }
+
+        return result;
+    }
+
+private:
+    using Fingerprint = std::pair<uint64_t, uint64_t>;
+
+    PackedReads<TValue> reads_;
+
+    static uint64_t mix(uint64_t h) {
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        h *= 0xc4ceb9fe1a85ec53ULL;
+        h ^= h >> 33;
+        return h;
+    }
+
+    // Two independent hashes of the length and the packed words
+    Fingerprint fingerprint(size_t j) const {
+        size_t len = reads_.length(j);
+        const uint64_t *words = reads_.words(j);
+        uint64_t h1 = mix(len ^ 0x9e3779b97f4a7c15ULL), h2 = mix(len + 0x632be59bd9b4e019ULL);
+        for (size_t w = 0; w < PackedReads<TValue>::num_words(len); ++w) {
+            h1 = mix(h1 ^ words[w]) * 0x9e3779b97f4a7c15ULL;
+            h2 = mix(h2 + words[w] * 0xbf58476d1ce4e5b9ULL) ^ (h2 >> 29);
+        }
+
+        return Fingerprint(h1, h2);
+    }
+};
+
+
 template <typename TValue, typename... Args>
 std::unique_ptr<Compressor> Compressor::factor(Compressor::Type type, Args&&... args) {
     switch (type) {
@@ -287,6 +710,12 @@ std::unique_ptr<Compressor> Compressor::factor(Compressor::Type type, Args&&...
             return std::unique_ptr<Compressor>(new HashCompressor(std::forward<Args>(args)...));
         case Compressor::Type::TrieCompressor:
             return std::unique_ptr<Compressor>(new TrieCompressor<TValue>(std::forward<Args>(args)...));
+        case Compressor::Type::PartitionedTrieCompressor:
+            return std::unique_ptr<Compressor>(new PartitionedTrieCompressor<TValue>(std::forward<Args>(args)...));
+        case Compressor::Type::RadixTrieCompressor:
+            return std::unique_ptr<Compressor>(new RadixTrieCompressor<TValue>(std::forward<Args>(args)...));
+        case Compressor::Type::FingerprintHashCompressor:
+            return std::unique_ptr<Compressor>(new FingerprintHashCompressor<TValue>(std::forward<Args>(args)...));
         default:
             return std::unique_ptr<Compressor>(nullptr);
     }
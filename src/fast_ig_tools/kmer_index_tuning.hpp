@@ -0,0 +1,121 @@
+#pragma once
+
+#include <algorithm>
+#include <numeric>
+#include <random>
+#include <vector>
+
+#include "ig_matcher.hpp"
+#include "packed_reads.hpp"
+
+
+// Expected cost of tauDistGraph construction with the given k and strategy
+struct KmerIndexCost {
+    unsigned K;
+    unsigned strategy;
+    size_t discarded_reads;
+    double dist_computations;
+};
+
+
+// Chooses k and strategy by the expected number of distance computations, which is extrapolated
+// from candidates of a random sample of reads among the sample itself
+class KmerIndexTuner {
+public:
+    KmerIndexTuner(const PackedReadStore &input_reads, unsigned tau, size_t sample_size, unsigned seed = 0) :
+            tau_(tau), num_reads_(input_reads.size()) {
+        for (size_t j = 0; j < input_reads.size(); ++j) {
+            lengths_.push_back(input_reads[j].length());
+        }
+        std::sort(lengths_.begin(), lengths_.end());
+
+        // Partial Fisher-Yates shuffle, sample is kept in input order
+        std::vector<size_t> indices(input_reads.size());
+        std::iota(indices.begin(), indices.end(), 0);
+        sample_size = std::min(sample_size, indices.size());
+        std::mt19937 rnd(seed);
+        for (size_t i = 0; i < sample_size; ++i) {
+            std::swap(indices[i], indices[i + rnd() % (indices.size() - i)]);
+        }
+        indices.resize(sample_size);
+        std::sort(indices.begin(), indices.end());
+        sample_ = input_reads.select(indices);
+    }
+
+    size_t sample_size() const { return sample_.size(); }
+
+    // The number of reads too short for the strategy
+    size_t discarded_reads(unsigned K, unsigned strategy) const {
+        size_t required_read_length = (strategy != 0) ? (K * (tau_ + strategy)) : 0;
+        return std::lower_bound(lengths_.cbegin(), lengths_.cend(), required_read_length) - lengths_.cbegin();
+    }
+
+    // Expected number of distance computations of tauDistGraph on all reads
+    double predicted_dist_computations(unsigned K, unsigned strategy) const {
+        return predicted_dist_computations(KmerIndex(sample_, K), K, strategy);
+    }
+
+    // Edges per distance computation on the sample
+    template<typename Tf>
+    double predicted_efficiency(const HalfSWDistance<Tf> &dist, unsigned K, unsigned strategy) const {
+        size_t num_of_dist_computations;
+        auto graph = tauDistGraph(sample_, KmerIndex(sample_, K), dist, tau_, K, strategy, num_of_dist_computations);
+        return num_of_dist_computations ? static_cast<double>(numEdges(graph)) / num_of_dist_computations : 0.;
+    }
+
+    // Costs of combinations that discard at most max_discarded reads, the cheapest first
+    std::vector<KmerIndexCost> rank(unsigned min_K, unsigned max_K, unsigned max_strategy,
+                                    size_t max_discarded) const {
+        std::vector<KmerIndexCost> costs;
+        for (unsigned K = min_K; K <= max_K; ++K) {
+            if (discarded_reads(K, 1) > max_discarded) {
+                break;
+            }
+
+            KmerIndex kmer2reads(sample_, K);
+            for (unsigned strategy = 1; strategy <= max_strategy; ++strategy) {
+                size_t discarded = discarded_reads(K, strategy);
+                if (discarded <= max_discarded) {
+                    costs.push_back({ K, strategy, discarded, predicted_dist_computations(kmer2reads, K, strategy) });
+                }
+            }
+        }
+
+        std::stable_sort(costs.begin(), costs.end(),
+                         [](const KmerIndexCost &a, const KmerIndexCost &b) {
+                             return a.dist_computations < b.dist_computations;
+                         });
+        return costs;
+    }
+
+private:
+    unsigned tau_;
+    size_t num_reads_;
+    std::vector<size_t> lengths_; // Sorted lengths of all reads
+    PackedReadStore sample_;
+
+    // Pairs examined by tauDistGraph within the sample scaled to all pairs of reads
+    double predicted_dist_computations(const KmerIndex &kmer2reads, unsigned K, unsigned strategy) const {
+        size_t pairs = 0;
+        SEQAN_OMP_PRAGMA(parallel)
+        {
+            CandidateScratch scratch;
+            SEQAN_OMP_PRAGMA(for schedule(dynamic, 8) reduction(+:pairs))
+            for (size_t j = 0; j < sample_.size(); ++j) {
+                size_t len_j = length(sample_[j]);
+                for (size_t i : find_candidates(sample_[j], kmer2reads, sample_.size(), tau_, K, strategy, scratch)) {
+                    size_t len_i = length(sample_[i]);
+                    pairs += len_j < len_i || (len_i == len_j && j < i);
+                }
+            }
+        }
+
+        size_t m = sample_.size();
+        if (m < 2) {
+            return static_cast<double>(pairs);
+        }
+        return static_cast<double>(pairs) * num_reads_ * (num_reads_ - 1) / (static_cast<double>(m) * (m - 1));
+    }
+};
+
+// vim: ts=4:sw=4
@@ -0,0 +1,341 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <vector>
+#include <openmp_wrapper.h>
+
+#include <seqan/sequence.h>
+#include <seqan/seq_io.h>
+
+#include "../graph_utils/const_array.hpp"
+
+
+// Read stored as 2-bit codes, 32 bases per 64-bit word, base i at bits [2*(i%32), 2*(i%32) + 2) of word i/32.
+// N is stored as A together with a mask word per code word that marks positions of Ns by the low bit of
+// the corresponding 2-bit slot. Reads without N have no mask at all.
+// Lightweight view, the data is owned by PackedReadStore
+class PackedRead {
+public:
+    PackedRead(const uint64_t *codes, const uint64_t *n_mask, size_t length) :
+            codes_(codes), n_mask_(n_mask), length_(length) { }
+
+    size_t length() const { return length_; }
+
+    size_t num_words() const { return (length_ + kBasesPerWord - 1) / kBasesPerWord; }
+
+    seqan::Dna5 operator[](size_t i) const {
+        size_t shift = 2 * (i % kBasesPerWord);
+        if (n_mask_ && ((n_mask_[i / kBasesPerWord] >> shift) & 1)) {
+            return seqan::Dna5('N');
+        }
+        return seqan::Dna5(static_cast<unsigned>((codes_[i / kBasesPerWord] >> shift) & 3));
+    }
+
+    const uint64_t *codes() const { return codes_; }
+
+    const uint64_t *n_mask() const { return n_mask_; }
+
+    // Codes of 32 bases starting from position pos in the layout of a single word, zero-filled beyond the read
+    uint64_t codes_at(size_t pos) const { return Window(codes_, pos); }
+
+    uint64_t n_mask_at(size_t pos) const { return n_mask_ ? Window(n_mask_, pos) : 0; }
+
+    static const size_t kBasesPerWord = 32;
+
+private:
+    uint64_t Window(const uint64_t *words, size_t pos) const {
+        size_t w = pos / kBasesPerWord;
+        size_t shift = 2 * (pos % kBasesPerWord);
+        uint64_t res = words[w] >> shift;
+        if (shift && w + 1 < num_words()) {
+            res |= words[w + 1] << (64 - shift);
+        }
+        return res;
+    }
+
+    const uint64_t *codes_;
+    const uint64_t *n_mask_;
+    size_t length_;
+};
+
+inline size_t length(const PackedRead &read) {
+    return read.length();
+}
+
+
+// Contiguous storage of packed reads and their identifiers. Every read starts at a word boundary,
+// identifiers are NUL-terminated strings of a single buffer (empty if reads were given without them).
+// Arrays are either owned or mapped from a file (see ReferenceIndex)
+class PackedReadStore {
+public:
+    // Random-access view of read identifiers convertible by seqan::toCString, e.g., for find_abundances
+    class Ids {
+    public:
+        explicit Ids(const PackedReadStore &store) : store_(&store) { }
+
+        size_t size() const { return store_->has_ids() ? store_->size() : 0; }
+
+        const char *operator[](size_t i) const { return store_->id(i); }
+
+    private:
+        const PackedReadStore *store_;
+    };
+
+    PackedReadStore() = default;
+
+    template<typename T>
+    explicit PackedReadStore(const std::vector<T> &reads) {
+        Build(reads);
+    }
+
+    PackedReadStore(const PackedReadStore&) = delete;
+    PackedReadStore& operator=(const PackedReadStore&) = delete;
+    PackedReadStore(PackedReadStore&&) = default;
+    PackedReadStore& operator=(PackedReadStore&&) = default;
+
+    // Packs records of a FASTA/FASTQ file one by one, so that no per-read sequences and identifiers are kept
+    static PackedReadStore read_file(const std::string &filename) {
+        seqan::SeqFileIn file(filename.c_str());
+        seqan::CharString id;
+        seqan::Dna5String read;
+
+        Buffers buffers;
+        while (!seqan::atEnd(file)) {
+            seqan::readRecord(id, read, file);
+            buffers.Append(read);
+            buffers.AppendId(seqan::toCString(id), seqan::length(id));
+        }
+
+        PackedReadStore store;
+        store.Assign(std::move(buffers));
+        return store;
+    }
+
+    // Copy of the given reads (with identifiers) in the given order
+    PackedReadStore select(const std::vector<size_t> &indices) const {
+        Buffers buffers;
+        for (size_t i : indices) {
+            buffers.Append((*this)[i]);
+            if (has_ids()) {
+                buffers.AppendId(id(i), id_offsets_[i + 1] - id_offsets_[i] - 1);
+            }
+        }
+
+        PackedReadStore store;
+        store.Assign(std::move(buffers));
+        return store;
+    }
+
+    size_t size() const { return lengths_.size(); }
+
+    PackedRead operator[](size_t i) const {
+        return PackedRead(words_.data() + offsets_[i],
+                          n_mask_offsets_[i] == kNoMask ? nullptr : words_.data() + n_mask_offsets_[i],
+                          lengths_[i]);
+    }
+
+    bool has_ids() const { return !id_offsets_.empty(); }
+
+    const char *id(size_t i) const { return ids_.data() + id_offsets_[i]; }
+
+    Ids ids() const { return Ids(*this); }
+
+    // Memory occupied by packed sequences, identifiers and their offsets, in bytes
+    size_t memory_usage() const {
+        return words_.size() * sizeof(uint64_t) +
+               (offsets_.size() + n_mask_offsets_.size() + lengths_.size() + id_offsets_.size()) * sizeof(size_t) +
+               ids_.size();
+    }
+
+private:
+    friend class ReferenceIndex;
+
+    static const size_t kNoMask = std::numeric_limits<size_t>::max();
+
+    ConstArray<uint64_t> words_;
+    ConstArray<size_t> offsets_;
+    ConstArray<size_t> n_mask_offsets_;
+    ConstArray<size_t> lengths_;
+    ConstArray<char> ids_;
+    ConstArray<size_t> id_offsets_;
+
+    template<typename T>
+    static bool HasN(const T &read, size_t len) {
+        for (size_t i = 0; i < len; ++i) {
+            if (seqan::ordValue(seqan::Dna5(read[i])) > 3) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Requires zero-filled codes (and n_mask if read contains N)
+    template<typename T>
+    static void Pack(const T &read, size_t len, uint64_t *codes, uint64_t *n_mask) {
+        const size_t B = PackedRead::kBasesPerWord;
+        for (size_t i = 0; i < len; ++i) {
+            unsigned c = seqan::ordValue(seqan::Dna5(read[i]));
+            size_t shift = 2 * (i % B);
+            if (c > 3) {
+                n_mask[i / B] |= uint64_t(1) << shift;
+            } else {
+                codes[i / B] |= uint64_t(c) << shift;
+            }
+        }
+    }
+
+    // Growing arrays of a store under sequential construction
+    struct Buffers {
+        std::vector<uint64_t> words;
+        std::vector<size_t> offsets;
+        std::vector<size_t> n_mask_offsets;
+        std::vector<size_t> lengths;
+        std::vector<char> ids;
+        std::vector<size_t> id_offsets;
+
+        template<typename T>
+        void Append(const T &read) {
+            using seqan::length;
+            const size_t B = PackedRead::kBasesPerWord;
+
+            size_t len = length(read);
+            size_t num_words = (len + B - 1) / B;
+            bool has_n = HasN(read, len);
+
+            lengths.push_back(len);
+            offsets.push_back(words.size());
+            n_mask_offsets.push_back(has_n ? words.size() + num_words : kNoMask);
+            words.resize(words.size() + (has_n ? 2 : 1) * num_words, 0);
+            Pack(read, len, words.data() + offsets.back(),
+                 has_n ? words.data() + n_mask_offsets.back() : nullptr);
+        }
+
+        void AppendId(const char *id, size_t len) {
+            id_offsets.push_back(ids.size());
+            ids.insert(ids.end(), id, id + len);
+            ids.push_back('\0');
+        }
+    };
+
+    void Assign(Buffers &&buffers) {
+        words_ = std::move(buffers.words);
+        offsets_ = std::move(buffers.offsets);
+        n_mask_offsets_ = std::move(buffers.n_mask_offsets);
+        lengths_ = std::move(buffers.lengths);
+        ids_ = std::move(buffers.ids);
+        if (!buffers.id_offsets.empty()) {
+            buffers.id_offsets.push_back(ids_.size());
+        }
+        id_offsets_ = std::move(buffers.id_offsets);
+    }
+
+    template<typename T>
+    void Build(const std::vector<T> &reads) {
+        using seqan::length;
+        const size_t B = PackedRead::kBasesPerWord;
+
+        std::vector<size_t> offsets(reads.size());
+        std::vector<size_t> n_mask_offsets(reads.size());
+        std::vector<size_t> lengths(reads.size());
+
+        size_t total = 0;
+        for (size_t j = 0; j < reads.size(); ++j) {
+            size_t len = length(reads[j]);
+            size_t words = (len + B - 1) / B;
+            bool has_n = HasN(reads[j], len);
+
+            lengths[j] = len;
+            offsets[j] = total;
+            total += words;
+            n_mask_offsets[j] = has_n ? total : kNoMask;
+            total += has_n ? words : 0;
+        }
+
+        std::vector<uint64_t> words(total, 0);
+
+        SEQAN_OMP_PRAGMA(parallel for schedule(static))
+        for (size_t j = 0; j < reads.size(); ++j) {
+            Pack(reads[j], lengths[j], words.data() + offsets[j],
+                 (n_mask_offsets[j] == kNoMask) ? nullptr : words.data() + n_mask_offsets[j]);
+        }
+
+        words_ = std::move(words);
+        offsets_ = std::move(offsets);
+        n_mask_offsets_ = std::move(n_mask_offsets);
+        lengths_ = std::move(lengths);
+    }
+};
+
+
+// Word with the low bit of 2-bit slot i set iff bases i of two packed words differ (N matches only N).
+// Ns are stored as A, so two Ns always agree by codes and differ only by masks
+inline uint64_t mismatch_bits(uint64_t codes1, uint64_t n_mask1, uint64_t codes2, uint64_t n_mask2) {
+    const uint64_t kLowBits = 0x5555555555555555ull;
+    uint64_t x = codes1 ^ codes2;
+    return ((x | (x >> 1)) & kLowBits) | (n_mask1 ^ n_mask2);
+}
+
+
+// Hamming distance between common prefixes of s1 and s2.
+// Compares 32 bases per word operation. Stops as soon as the distance exceeds limit,
+// in that case some value greater than limit is returned
+inline size_t hamming_distance(const PackedRead &s1, const PackedRead &s2,
+                               size_t limit = std::numeric_limits<size_t>::max()) {
+    const size_t B = PackedRead::kBasesPerWord;
+
+    size_t len = std::min(s1.length(), s2.length());
+    size_t full_words = len / B;
+    size_t rest = len % B;
+
+    const uint64_t *a = s1.codes(), *b = s2.codes();
+    const uint64_t *na = s1.n_mask(), *nb = s2.n_mask();
+
+    auto mismatches = [&](size_t w) -> uint64_t {
+        return mismatch_bits(a[w], na ? na[w] : 0, b[w], nb ? nb[w] : 0);
+    };
+
+    size_t res = 0;
+    for (size_t w = 0; w < full_words; ++w) {
+        res += __builtin_popcountll(mismatches(w));
+        if (res > limit) {
+            return res;
+        }
+    }
+
+    if (rest) {
+        uint64_t tail_mask = (uint64_t(1) << (2 * rest)) - 1;
+        res += __builtin_popcountll(mismatches(full_words) & tail_mask);
+    }
+
+    return res;
+}
+
+
+// The number of equal bases of s1 and s2 starting from positions p1 and p2 respectively, at most max_len.
+// Requires p1 + max_len <= length(s1), p2 + max_len <= length(s2). Compares 32 bases per step
+inline size_t common_prefix_length(const PackedRead &s1, size_t p1,
+                                   const PackedRead &s2, size_t p2,
+                                   size_t max_len) {
+    const size_t B = PackedRead::kBasesPerWord;
+
+    size_t res = 0;
+    while (res < max_len) {
+        uint64_t x = mismatch_bits(s1.codes_at(p1 + res), s1.n_mask_at(p1 + res),
+                                   s2.codes_at(p2 + res), s2.n_mask_at(p2 + res));
+        size_t chunk = std::min(B, max_len - res);
+        if (chunk < B) {
+            x &= (uint64_t(1) << (2 * chunk)) - 1;
+        }
+        if (x) {
+            return res + static_cast<size_t>(__builtin_ctzll(x)) / 2;
+        }
+        res += chunk;
+    }
+
+    return res;
+}
+
+// vim: ts=4:sw=4
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <algorithm>
+#include <limits>
+#include <numeric>
+#include <vector>
+#include <openmp_wrapper.h>
+#include <parallel_wrapper.hpp>
+
+#include "banded_half_smith_waterman.hpp"
+#include "../algorithms/hashes/polyhashes.hpp"
+
+
+// Orders of reads that put similar reads next to each other, so that candidates of a query are close to it
+// in memory. Both return original indices of reads in the new order, i.e., read j goes to the position
+// of j in the result. Reads with equal keys are ordered by length and then by index
+
+
+// By the minimal hash of k-mers of a read. Reads sharing their first k-mers (e.g., reads of one clonotype)
+// usually share the minimal one too. Reads shorter than K go to the end
+template<typename TReads>
+std::vector<size_t> minimizer_order(const TReads &input_reads, size_t K) {
+    struct Key {
+        size_t minimizer;
+        size_t length;
+        size_t index;
+
+        bool operator<(const Key &other) const {
+            return minimizer < other.minimizer ||
+                   (minimizer == other.minimizer && (length < other.length ||
+                                                     (length == other.length && index < other.index)));
+        }
+    };
+
+    std::vector<Key> keys(input_reads.size());
+    SEQAN_OMP_PRAGMA(parallel for schedule(dynamic, 64))
+    for (size_t j = 0; j < input_reads.size(); ++j) {
+        const auto &read = input_reads[j];
+        size_t minimizer = std::numeric_limits<size_t>::max();
+        for (const auto &kmer : algorithms::kmer_hashes(read, K)) {
+            minimizer = std::min(minimizer, kmer.hash);
+        }
+        keys[j] = { minimizer, length(read), j };
+    }
+    parallel::sort(keys.begin(), keys.end());
+
+    std::vector<size_t> order(keys.size());
+    for (size_t i = 0; i < keys.size(); ++i) {
+        order[i] = keys[i].index;
+    }
+    return order;
+}
+
+
+// Lexicographic order of sequences, a proper prefix goes first
+template<typename TReads>
+std::vector<size_t> lexicographic_order(const TReads &input_reads) {
+    std::vector<size_t> order(input_reads.size());
+    std::iota(order.begin(), order.end(), 0);
+    parallel::sort(order.begin(), order.end(),
+                   [&input_reads](size_t j1, size_t j2) -> bool {
+                       const auto &s1 = input_reads[j1];
+                       const auto &s2 = input_reads[j2];
+                       size_t len1 = length(s1), len2 = length(s2);
+                       size_t common = common_prefix_length(s1, 0, s2, 0, std::min(len1, len2));
+                       if (common < std::min(len1, len2)) {
+                           return seqan::ordValue(s1[common]) < seqan::ordValue(s2[common]);
+                       }
+                       return len1 < len2 || (len1 == len2 && j1 < j2);
+                   });
+    return order;
+}
+
+// vim: ts=4:sw=4
@@ -0,0 +1,134 @@
+#include <algorithm>
+#include <fstream>
+#include <memory>
+#include <verify.hpp>
+
+#include "reference_index.hpp"
+#include "../graph_utils/mapped_file.hpp"
+
+static_assert(sizeof(ReferenceIndexHeader) == 80, "reference index header must be 8-byte aligned");
+
+const char ReferenceIndexHeader::kMagic[8] = { 'I', 'G', 'R', 'R', 'E', 'F', 'X', '\0' };
+
+namespace {
+    size_t padded_size(size_t bytes) {
+        return (bytes + 7) / 8 * 8;
+    }
+
+    template<typename T>
+    void write_padded_array(std::ofstream &out, const ConstArray<T> &array) {
+        size_t bytes = array.size() * sizeof(T);
+        out.write(reinterpret_cast<const char*>(array.data()), static_cast<std::streamsize>(bytes));
+        const char zeros[8] = { 0 };
+        out.write(zeros, static_cast<std::streamsize>(padded_size(bytes) - bytes));
+    }
+}
+
+size_t ReferenceIndexHeader::FileSize() const {
+    return sizeof(ReferenceIndexHeader) +
+           padded_size((2 * num_keys + 1 + directory_size + 3 * num_reads + num_words) * sizeof(uint64_t)) +
+           padded_size(num_postings * sizeof(KmerIndex::ReadIndex));
+}
+
+uint64_t file_checksum(const std::string &filename) {
+    std::ifstream in(filename, std::ios::binary);
+    VERIFY_MSG(in, "Cannot open " << filename);
+
+    uint64_t hash = 0xcbf29ce484222325ull;
+    std::vector<char> buffer(1 << 20);
+    while (in.read(buffer.data(), buffer.size()) || in.gcount()) {
+        for (std::streamsize i = 0; i < in.gcount(); ++i) {
+            hash ^= static_cast<unsigned char>(buffer[i]);
+            hash *= 0x100000001b3ull;
+        }
+    }
+    return hash;
+}
+
+void ReferenceIndex::save(const std::string &filename) const {
+    ReferenceIndexHeader header;
+    std::copy(ReferenceIndexHeader::kMagic, ReferenceIndexHeader::kMagic + sizeof(header.magic), header.magic);
+    header.version = ReferenceIndexHeader::kVersion;
+    header.word_size = sizeof(size_t);
+    header.K = static_cast<uint32_t>(kmer_index_.K_);
+    header.strategy = strategy_;
+    header.source_checksum = source_checksum_;
+    header.num_reads = reads_.size();
+    header.num_words = reads_.words_.size();
+    header.num_keys = kmer_index_.keys_.size();
+    header.num_postings = kmer_index_.postings_.size();
+    header.directory_size = kmer_index_.directory_.size();
+    header.directory_shift = kmer_index_.shift_;
+
+    std::ofstream out(filename, std::ios::binary);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    write_padded_array(out, kmer_index_.keys_);
+    write_padded_array(out, kmer_index_.offsets_);
+    write_padded_array(out, kmer_index_.directory_);
+    write_padded_array(out, reads_.offsets_);
+    write_padded_array(out, reads_.n_mask_offsets_);
+    write_padded_array(out, reads_.lengths_);
+    write_padded_array(out, reads_.words_);
+    write_padded_array(out, kmer_index_.postings_);
+    VERIFY_MSG(out.good(), "Failed to write reference index to " << filename);
+}
+
+ReferenceIndex ReferenceIndex::load(const std::string &filename) {
+    auto file = std::make_shared<MappedFile>(filename);
+    VERIFY_MSG(file->Good() && file->Size() >= sizeof(ReferenceIndexHeader), "Cannot read reference index " << filename);
+    const ReferenceIndexHeader &header = *reinterpret_cast<const ReferenceIndexHeader*>(file->Data());
+    VERIFY_MSG(std::equal(header.magic, header.magic + sizeof(header.magic), ReferenceIndexHeader::kMagic),
+               "File " << filename << " is not a reference index");
+    VERIFY_MSG(header.version == ReferenceIndexHeader::kVersion,
+               "Unsupported version " << header.version << " of reference index " << filename);
+    VERIFY_MSG(header.word_size == sizeof(size_t),
+               "Reference index " << filename << " was written with " << header.word_size << "-byte words");
+    VERIFY_MSG(file->Size() == header.FileSize(), "Reference index " << filename << " is truncated");
+
+    const char *p = file->Data() + sizeof(ReferenceIndexHeader);
+    auto take = [&p, &file](size_t size, ConstArray<size_t> &array) {
+        array = ConstArray<size_t>(reinterpret_cast<const size_t*>(p), size, file);
+        p += size * sizeof(size_t);
+    };
+
+    ReferenceIndex index;
+    index.strategy_ = header.strategy;
+    index.source_checksum_ = header.source_checksum;
+
+    KmerIndex &kmer_index = index.kmer_index_;
+    kmer_index.K_ = header.K;
+    kmer_index.num_reads_ = header.num_reads;
+    kmer_index.shift_ = static_cast<unsigned>(header.directory_shift);
+    take(header.num_keys, kmer_index.keys_);
+    take(header.num_keys + 1, kmer_index.offsets_);
+    take(header.directory_size, kmer_index.directory_);
+
+    PackedReadStore &reads = index.reads_;
+    take(header.num_reads, reads.offsets_);
+    take(header.num_reads, reads.n_mask_offsets_);
+    take(header.num_reads, reads.lengths_);
+    reads.words_ = ConstArray<uint64_t>(reinterpret_cast<const uint64_t*>(p), header.num_words, file);
+    p += header.num_words * sizeof(uint64_t);
+
+    kmer_index.postings_ = ConstArray<KmerIndex::ReadIndex>(reinterpret_cast<const KmerIndex::ReadIndex*>(p),
+                                                            header.num_postings, file);
+    return index;
+}
+
+ReferenceIndex load_reference_index(const std::string &filename,
+                                    size_t K, unsigned strategy,
+                                    const std::string &source_file) {
+    ReferenceIndex index = ReferenceIndex::load(filename);
+    VERIFY_MSG(index.K() == K, "Reference index " << filename << " was built with k = " << index.K() << ", not " << K);
+    if (source_file != "") {
+        VERIFY_MSG(index.source_checksum() == file_checksum(source_file),
+                   "Reference index " << filename << " is stale: it was not built from " << source_file);
+    }
+    if (index.strategy() != strategy) {
+        WARN("Reference index " << filename << " was built for strategy " << index.strategy() <<
+             ", strategy " << strategy << " is used");
+    }
+    return index;
+}
+
+// vim: ts=4:sw=4
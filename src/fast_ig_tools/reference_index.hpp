@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "ig_matcher.hpp"
+#include "packed_reads.hpp"
+
+
+// Header of a reference index file. It is followed by 8-byte aligned arrays:
+// k-mer keys, offsets, directory and postings of KmerIndex, then offsets, N mask offsets, lengths and words
+// of PackedReadStore. The header records k, strategy and checksum of the source FASTA to reject stale indexes
+struct ReferenceIndexHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t word_size;
+    uint32_t K;
+    uint32_t strategy;
+    uint64_t source_checksum;
+    uint64_t num_reads;
+    uint64_t num_words;
+    uint64_t num_keys;
+    uint64_t num_postings;
+    uint64_t directory_size;
+    uint64_t directory_shift;
+
+    static const char kMagic[8];
+    static const uint32_t kVersion = 1;
+
+    // Size of the whole file in bytes
+    size_t FileSize() const;
+};
+
+
+// FNV-1a hash of file contents
+uint64_t file_checksum(const std::string &filename);
+
+
+// Packed reference reads together with their k-mer index.
+// A loaded index is memory-mapped, i.e., loading takes time independent of the reference size
+class ReferenceIndex {
+public:
+    ReferenceIndex() = default;
+    ReferenceIndex(ReferenceIndex &&) = default;
+    ReferenceIndex &operator=(ReferenceIndex &&) = default;
+
+    ReferenceIndex(PackedReadStore reads, size_t K, unsigned strategy, uint64_t source_checksum = 0) :
+            reads_(std::move(reads)), kmer_index_(reads_, K), strategy_(strategy), source_checksum_(source_checksum) { }
+
+    const PackedReadStore& reads() const { return reads_; }
+
+    const KmerIndex& kmer_index() const { return kmer_index_; }
+
+    size_t K() const { return kmer_index_.K(); }
+
+    // Strategy the index was built for. The index itself does not depend on it
+    unsigned strategy() const { return strategy_; }
+
+    uint64_t source_checksum() const { return source_checksum_; }
+
+    void save(const std::string &filename) const;
+
+    static ReferenceIndex load(const std::string &filename);
+
+private:
+    PackedReadStore reads_;
+    KmerIndex kmer_index_;
+    unsigned strategy_ = 0;
+    uint64_t source_checksum_ = 0;
+};
+
+
+// Loads the index and checks it against the options it is going to be used with.
+// Empty source_file skips the check of the source FASTA
+ReferenceIndex load_reference_index(const std::string &filename,
+                                    size_t K, unsigned strategy,
+                                    const std::string &source_file = "");
+
+// vim: ts=4:sw=4
@@ -0,0 +1,627 @@
+#include <gmock/gmock.h>
+
+#include <fstream>
+#include <functional>
+#include <random>
+#include <map>
+
+#include "ig_matcher.hpp"
+#include "packed_reads.hpp"
+#include "banded_half_smith_waterman.hpp"
+#include "csr_graph_io.hpp"
+#include "reference_index.hpp"
+#include "kmer_index_tuning.hpp"
+#include "read_order.hpp"
+
+using seqan::Dna5String;
+using namespace ::testing;
+
+namespace {
+
+std::vector<Dna5String> random_reads(size_t n, size_t min_len, size_t max_len, unsigned seed) {
+    std::mt19937 rnd(seed);
+    std::vector<Dna5String> reads;
+    const std::string alphabet = "ACGTN";
+    for (size_t i = 0; i < n; ++i) {
+        size_t len = min_len + rnd() % (max_len - min_len + 1);
+        std::string s;
+        for (size_t j = 0; j < len; ++j) {
+            // Rare Ns and a small alphabet prefix to get shared k-mers
+            s += (rnd() % 50 == 0) ? alphabet[4] : alphabet[rnd() % ((j < 10) ? 2 : 4)];
+        }
+        reads.push_back(Dna5String(s));
+    }
+    return reads;
+}
+
+Dna5String mutate(const Dna5String &read, size_t num_mutations, std::mt19937 &rnd) {
+    const std::string alphabet = "ACGTN";
+    std::string s;
+    for (size_t i = 0; i < length(read); ++i) {
+        s += static_cast<char>(read[i]);
+    }
+    for (size_t m = 0; m < num_mutations; ++m) {
+        size_t pos = s.empty() ? 0 : rnd() % s.size();
+        switch (rnd() % 3) {
+            case 0: if (!s.empty()) s[pos] = alphabet[rnd() % 4]; break;
+            case 1: if (!s.empty()) s.erase(pos, 1); break;
+            default: s.insert(pos, 1, alphabet[rnd() % 4]);
+        }
+    }
+    return Dna5String(s);
+}
+
+// Clones of random reads (see random_reads): copies(b) reads of the b-th one of num_bases with at most
+// max_mutations mutations each
+std::vector<Dna5String> clustered_reads(size_t num_bases, size_t min_len, size_t max_len,
+                                        const std::function<size_t(size_t)> &copies,
+                                        size_t max_mutations, unsigned seed) {
+    std::mt19937 rnd(seed);
+    auto bases = random_reads(num_bases, min_len, max_len, seed + 1);
+    std::vector<Dna5String> reads;
+    for (size_t b = 0; b < bases.size(); ++b) {
+        for (size_t m = 0; m < copies(b); ++m) {
+            reads.push_back(mutate(bases[b], rnd() % (max_mutations + 1), rnd));
+        }
+    }
+    return reads;
+}
+
+std::vector<Dna5String> clustered_reads(size_t num_bases, size_t min_len, size_t max_len,
+                                        size_t copies, size_t max_mutations, unsigned seed) {
+    return clustered_reads(num_bases, min_len, max_len, [copies](size_t) { return copies; }, max_mutations, seed);
+}
+
+}
+
+TEST(kmer_index, matches_naive_index) {
+    auto reads = random_reads(500, 0, 60, 42);
+    const size_t K = 5;
+
+    std::map<size_t, std::vector<size_t>> naive;
+    for (size_t j = 0; j < reads.size(); ++j) {
+        for (const auto &kmer : algorithms::kmer_hashes(reads[j], K)) {
+            naive[kmer.hash].push_back(j);
+        }
+    }
+    for (auto &kv : naive) {
+        remove_duplicates(kv.second, true);
+    }
+
+    auto index = kmerIndexConstruction(reads, K);
+    EXPECT_EQ(index.size(), naive.size());
+
+    size_t num_postings = 0;
+    for (const auto &kv : naive) {
+        auto postings = index.find(kv.first);
+        std::vector<size_t> found(postings.begin(), postings.end());
+        EXPECT_EQ(found, kv.second);
+        num_postings += kv.second.size();
+    }
+    EXPECT_EQ(index.num_postings(), num_postings);
+
+    for (size_t hash = 0; hash < 20000; ++hash) {
+        if (!naive.count(hash)) {
+            EXPECT_TRUE(index.find(hash).empty());
+        }
+    }
+    EXPECT_TRUE(index.find(std::numeric_limits<size_t>::max()).empty());
+}
+
+TEST(kmer_index, empty_input) {
+    std::vector<Dna5String> reads = { Dna5String("ACG"), Dna5String("") };
+    auto index = kmerIndexConstruction(reads, 5);
+
+    EXPECT_EQ(index.size(), 0u);
+    EXPECT_TRUE(index.find(0).empty());
+}
+
+TEST(kmer_hashes, rolling_matches_direct) {
+    auto reads = random_reads(200, 0, 80, 7);
+    for (size_t K : { 1, 5, 31, 32, 33, 40 }) {
+        for (const auto &read : reads) {
+            size_t expected_position = 0;
+            for (const auto &kmer : algorithms::kmer_hashes(read, K)) {
+                EXPECT_EQ(kmer.position, expected_position++);
+                EXPECT_EQ(kmer.hash, algorithms::kmer_hash(read, kmer.position, K));
+            }
+            EXPECT_EQ(expected_position, algorithms::kmer_hashes(read, K).NumWindows());
+        }
+    }
+}
+
+TEST(kmer_hashes, skip_windows_with_n) {
+    Dna5String read = "ACGTNACGTACNGT";
+    std::vector<size_t> positions;
+    for (const auto &kmer : algorithms::kmer_hashes(read, 3, algorithms::NPolicy::Skip)) {
+        positions.push_back(kmer.position);
+        EXPECT_EQ(kmer.hash, algorithms::kmer_hash(read, kmer.position, 3));
+    }
+    EXPECT_EQ(positions, std::vector<size_t>({ 0, 1, 5, 6, 7, 8 }));
+    EXPECT_EQ(algorithms::kmer_hash(read, 0, 4), algorithms::kmer_hash(Dna5String("ACGT"), 0, 4));
+}
+
+TEST(packed_reads, unpack) {
+    auto reads = random_reads(300, 0, 150, 11);
+    PackedReadStore store(reads);
+    ASSERT_EQ(store.size(), reads.size());
+    for (size_t j = 0; j < reads.size(); ++j) {
+        ASSERT_EQ(length(store[j]), length(reads[j]));
+        for (size_t i = 0; i < length(reads[j]); ++i) {
+            EXPECT_EQ(seqan::ordValue(store[j][i]), seqan::ordValue(reads[j][i]));
+        }
+    }
+}
+
+TEST(packed_reads, hamming_distance) {
+    auto reads = random_reads(150, 0, 150, 13);
+    PackedReadStore store(reads);
+    for (size_t j1 = 0; j1 < reads.size(); ++j1) {
+        for (size_t j2 = 0; j2 < reads.size(); ++j2) {
+            size_t expected = static_cast<size_t>(hamming_rtrim(reads[j1], reads[j2]));
+            EXPECT_EQ(hamming_distance(store[j1], store[j2]), expected);
+            for (size_t limit : { 0, 3, 40 }) {
+                size_t bounded = hamming_distance(store[j1], store[j2], limit);
+                EXPECT_EQ(bounded <= limit, expected <= limit);
+                if (expected <= limit) {
+                    EXPECT_EQ(bounded, expected);
+                }
+            }
+        }
+    }
+}
+
+TEST(half_edit_dist_banded, matches_half_sw_banded) {
+    auto reads = clustered_reads(60, 0, 90, 4, 6, 19);
+    PackedReadStore store(reads);
+
+    for (size_t j1 = 0; j1 < reads.size(); ++j1) {
+        for (size_t j2 = j1 - j1 % 4; j2 < j1 - j1 % 4 + 4; ++j2) {
+            for (int max_indels : { 0, 1, 2, 5 }) {
+                for (int tail : { 0, 3, 100 }) {
+                    auto lizard_tail = [tail](int l) -> int { return l ? -tail : 0; };
+                    auto tail_cost = [tail](int l) -> size_t { return l ? tail : 0; };
+                    size_t expected = -half_sw_banded(reads[j1], reads[j2], 0, -1, -1, lizard_tail, max_indels);
+                    for (size_t limit : { 0, 2, 4, 1000 }) {
+                        size_t clipped = std::min(expected, limit + 1);
+                        EXPECT_EQ(half_edit_dist_banded(reads[j1], reads[j2], tail_cost, max_indels, limit), clipped);
+                        EXPECT_EQ(half_edit_dist_banded(store[j1], store[j2], tail_cost, max_indels, limit), clipped);
+                    }
+                }
+            }
+        }
+    }
+}
+
+TEST(dist_at_most_batch, matches_dist_at_most) {
+    auto reads = clustered_reads(10, 0, 150, 10, 5, 23);
+    PackedReadStore store(reads);
+
+    // Candidates of all lengths relative to the query, the last block is either compared one by one (1 candidate)
+    // or partial (11 candidates)
+    std::vector<size_t> indices(reads.size() - 3);
+    std::iota(indices.begin(), indices.end(), 2);
+    std::vector<size_t> result(indices.size());
+
+    for (size_t max_indels : { 0, 1, 2, 4 }) {
+        for (size_t tail : { 0, 1, 100 }) {
+            auto dist = half_sw_distance(max_indels, [tail](int l) -> size_t { return l ? tail : 0; });
+            for (size_t tau : { 0, 1, 3, 8 }) {
+                for (size_t j = 0; j < reads.size(); j += 7) {
+                    size_t n = (j % 2) ? indices.size() : indices.size() - 6;
+                    dist_at_most_batch(dist, store[j], store, indices.data(), n, tau, result.data());
+                    for (size_t k = 0; k < n; ++k) {
+                        ASSERT_EQ(result[k], dist.dist_at_most(store[j], store[indices[k]], tau))
+                            << "query " << j << ", candidate " << indices[k] << ", max indels " << max_indels;
+                    }
+                }
+            }
+        }
+    }
+}
+
+TEST(packed_reads, common_prefix_length) {
+    auto reads = random_reads(40, 0, 100, 23);
+    PackedReadStore store(reads);
+    for (size_t j1 = 0; j1 < reads.size(); ++j1) {
+        for (size_t j2 = 0; j2 < reads.size(); ++j2) {
+            for (size_t p1 = 0; p1 < length(reads[j1]); p1 += 7) {
+                for (size_t p2 = 0; p2 < length(reads[j2]); p2 += 5) {
+                    size_t max_len = std::min(length(reads[j1]) - p1, length(reads[j2]) - p2);
+                    EXPECT_EQ(common_prefix_length(store[j1], p1, store[j2], p2, max_len),
+                              common_prefix_length(reads[j1], p1, reads[j2], p2, max_len));
+                }
+            }
+        }
+    }
+}
+
+TEST(packed_reads, read_file_and_select) {
+    auto reads = random_reads(100, 1, 120, 41);
+    {
+        std::ofstream out("test_ig_matcher_reads.fa");
+        for (size_t j = 0; j < reads.size(); ++j) {
+            out << ">read_" << j << "\n" << reads[j] << "\n";
+        }
+    }
+    auto store = PackedReadStore::read_file("test_ig_matcher_reads.fa");
+    std::remove("test_ig_matcher_reads.fa");
+
+    ASSERT_EQ(store.size(), reads.size());
+    ASSERT_EQ(store.ids().size(), reads.size());
+    for (size_t j = 0; j < reads.size(); ++j) {
+        EXPECT_EQ(std::string(store.id(j)), "read_" + std::to_string(j));
+        ASSERT_EQ(length(store[j]), length(reads[j]));
+        for (size_t i = 0; i < length(reads[j]); ++i) {
+            ASSERT_EQ(seqan::ordValue(store[j][i]), seqan::ordValue(reads[j][i]));
+        }
+    }
+
+    std::vector<size_t> indices = { 7, 3, 99, 3 };
+    auto selected = store.select(indices);
+    ASSERT_EQ(selected.size(), indices.size());
+    for (size_t k = 0; k < indices.size(); ++k) {
+        const auto &read = reads[indices[k]];
+        EXPECT_EQ(std::string(selected.id(k)), store.id(indices[k]));
+        ASSERT_EQ(length(selected[k]), length(read));
+        for (size_t i = 0; i < length(read); ++i) {
+            ASSERT_EQ(seqan::ordValue(selected[k][i]), seqan::ordValue(read[i]));
+        }
+    }
+}
+
+TEST(tau_dist_graph, bounded_distance_matches_full) {
+    auto reads = clustered_reads(50, 40, 90, 6, 2, 31);
+    PackedReadStore store(reads);
+    const unsigned tau = 3, K = 5;
+    auto kmer2reads = kmerIndexConstruction(reads, K);
+
+    for (size_t max_indels : { 0, 2 }) {
+        auto tail_cost = [](int l) -> size_t { return l ? 2 * tau : 0; };
+        auto dist = half_sw_distance(max_indels, tail_cost);
+        auto full_dist = [&dist](const Dna5String &s1, const Dna5String &s2) -> size_t { return dist(s1, s2); };
+
+        size_t num_full, num_bounded, num_packed;
+        auto full = tauDistGraph(reads, kmer2reads, full_dist, tau, K, 1, num_full);
+        auto bounded = tauDistGraph(reads, kmer2reads, dist, tau, K, 1, num_bounded);
+        auto packed = tauDistGraph(store, kmer2reads, dist, tau, K, 1, num_packed);
+
+        EXPECT_EQ(bounded, full);
+        EXPECT_EQ(packed, full);
+        EXPECT_EQ(num_bounded, num_full);
+        EXPECT_GT(numEdges(full), reads.size() / 2);
+    }
+}
+
+TEST(tau_dist_graph, query_order_does_not_change_graph) {
+    // Clones of very different sizes
+    auto reads = clustered_reads(40, 40, 90, [](size_t b) { return 1 + (b % 5) * (b % 5) * 3; }, 2, 41);
+    PackedReadStore store(reads);
+    const unsigned tau = 3, K = 5;
+    auto kmer2reads = kmerIndexConstruction(reads, K);
+
+    CandidateScratch scratch;
+    auto order = query_order(store, kmer2reads, store.size(), tau, K, 1, 0, store.size(), true);
+    std::vector<size_t> sorted_order = order;
+    std::sort(sorted_order.begin(), sorted_order.end());
+    std::vector<size_t> all(store.size());
+    std::iota(all.begin(), all.end(), 0);
+    EXPECT_EQ(sorted_order, all);
+    for (size_t q = 1; q < order.size(); ++q) {
+        EXPECT_GE(predicted_candidates_num(store[order[q - 1]], kmer2reads, store.size(), tau, K, 1, scratch),
+                  predicted_candidates_num(store[order[q]], kmer2reads, store.size(), tau, K, 1, scratch));
+    }
+
+    auto tail_cost = [](int l) -> size_t { return l ? 2 * tau : 0; };
+    auto dist = half_sw_distance(2, tail_cost);
+    QuerySchedule by_cost, by_input;
+    by_input.by_cost = false;
+    size_t num_by_cost, num_by_input;
+    auto graph_by_cost = tauDistGraph(store, kmer2reads, dist, tau, K, 1, num_by_cost, ReadRange::All(), &by_cost);
+    auto graph_by_input = tauDistGraph(store, kmer2reads, dist, tau, K, 1, num_by_input, ReadRange::All(), &by_input);
+
+    EXPECT_EQ(graph_by_cost, graph_by_input);
+    EXPECT_EQ(num_by_cost, num_by_input);
+    EXPECT_EQ(by_cost.busy_time.size(), static_cast<size_t>(omp_get_max_threads()));
+    EXPECT_GT(numEdges(graph_by_cost), 0u);
+}
+
+TEST(tau_dist_graph, schedule_counters) {
+    auto reads = clustered_reads(30, 40, 90, 5, 2, 43);
+    PackedReadStore store(reads);
+    const unsigned tau = 3, K = 5;
+    auto kmer2reads = kmerIndexConstruction(store, K);
+    auto tail_cost = [](int l) -> size_t { return l ? 2 : 0; };
+    auto dist = half_sw_distance(1, tail_cost);
+
+    QuerySchedule schedule;
+    schedule.progress_interval = 1e-9; // Reports after every query
+    size_t num, num_expected;
+    auto graph = tauDistGraph(store, kmer2reads, dist, tau, K, 1, num, ReadRange::All(), &schedule);
+    auto expected = tauDistGraph(store, kmer2reads, dist, tau, K, 1, num_expected);
+
+    EXPECT_EQ(graph, expected);
+    EXPECT_EQ(num, num_expected);
+    EXPECT_EQ(schedule.dist_computations, num);
+    EXPECT_EQ(schedule.edges, numEdges(graph));
+    EXPECT_GE(schedule.candidates, num);
+    EXPECT_GT(schedule.edges, 0u);
+    EXPECT_GE(schedule.candidates_time, 0.);
+    EXPECT_GE(schedule.verification_time, 0.);
+}
+
+TEST(tau_dist_graph, read_order_does_not_change_graph) {
+    auto reads = clustered_reads(40, 40, 90, 6, 2, 47);
+    std::mt19937 rnd(43);
+    std::shuffle(reads.begin(), reads.end(), rnd);
+    PackedReadStore store(reads);
+    const unsigned tau = 3, K = 5;
+    auto tail_cost = [](int l) -> size_t { return l ? 2 : 0; };
+    auto dist = half_sw_distance(2, tail_cost);
+
+    size_t num_expected;
+    auto expected = tauDistGraph(store, kmerIndexConstruction(store, K), dist, tau, K, 1, num_expected);
+    EXPECT_GT(numEdges(expected), 0u);
+
+    for (const auto &order : { minimizer_order(store, K), lexicographic_order(store) }) {
+        std::vector<size_t> sorted_order = order;
+        std::sort(sorted_order.begin(), sorted_order.end());
+        for (size_t j = 0; j < sorted_order.size(); ++j) {
+            ASSERT_EQ(sorted_order[j], j);
+        }
+
+        auto reordered = store.select(order);
+        size_t num;
+        auto graph = tauDistGraph(reordered, kmerIndexConstruction(reordered, K), dist, tau, K, 1, num,
+                                  ReadRange::All(), nullptr, &order);
+        EXPECT_EQ(renumber_vertices(graph, order), expected);
+        EXPECT_EQ(num, num_expected);
+    }
+}
+
+TEST(kmer_index_tuner, exact_on_full_sample) {
+    auto reads = clustered_reads(30, 40, 90, 5, 2, 47);
+    const unsigned tau = 2;
+    auto tail_cost = [](int l) -> size_t { return l ? 2 * tau : 0; };
+    auto dist = half_sw_distance(0, tail_cost);
+
+    KmerIndexTuner tuner(PackedReadStore(reads), tau, reads.size() + 10);
+    EXPECT_EQ(tuner.sample_size(), reads.size());
+
+    auto costs = tuner.rank(5, 12, 3, 0);
+    ASSERT_FALSE(costs.empty());
+    for (size_t i = 0; i < costs.size(); ++i) {
+        EXPECT_EQ(costs[i].discarded_reads, 0u);
+        EXPECT_EQ(tuner.discarded_reads(costs[i].K, costs[i].strategy), 0u);
+        if (i) {
+            EXPECT_LE(costs[i - 1].dist_computations, costs[i].dist_computations);
+        }
+
+        size_t num_of_dist_computations;
+        auto kmer2reads = kmerIndexConstruction(reads, costs[i].K);
+        tauDistGraph(reads, kmer2reads, dist, tau, costs[i].K, costs[i].strategy, num_of_dist_computations);
+        EXPECT_EQ(costs[i].dist_computations, static_cast<double>(num_of_dist_computations));
+    }
+}
+
+TEST(csr_graph, from_edge_buffers_matches_adjacency_lists) {
+    std::mt19937 rnd(37);
+    const size_t N = 200;
+    for (bool symmetric : { true, false }) {
+        std::vector<std::vector<WeightedEdge>> buffers(3);
+        Graph expected(N);
+        for (size_t i = 0; i < N; ++i) {
+            for (size_t j = symmetric ? i + 1 : 0; j < N; ++j) {
+                if (rnd() % 20 == 0) {
+                    int dist = static_cast<int>(rnd() % 5);
+                    buffers[rnd() % buffers.size()].push_back( { i, j, dist } );
+                    expected[i].push_back( { j, dist } );
+                    if (symmetric) {
+                        expected[j].push_back( { i, dist } );
+                    }
+                }
+            }
+        }
+
+        auto graph = CsrGraph::FromEdgeBuffers(N, buffers, symmetric);
+
+        ASSERT_EQ(graph.size(), N);
+        EXPECT_EQ(numEdges(graph, symmetric), numEdges(expected, symmetric));
+        for (size_t i = 0; i < N; ++i) {
+            std::sort(expected[i].begin(), expected[i].end());
+            EXPECT_EQ(Graph::value_type(graph[i].begin(), graph[i].end()), expected[i]);
+        }
+        for (const auto &buffer : buffers) {
+            EXPECT_TRUE(buffer.empty());
+        }
+    }
+}
+
+TEST(graph_shards, merged_shards_match_full_graph) {
+    auto reads = clustered_reads(40, 40, 90, 5, 2, 43);
+    const unsigned tau = 3, K = 5;
+    auto kmer2reads = kmerIndexConstruction(reads, K);
+    auto dist = half_sw_distance(2, [](int l) -> size_t { return l ? 2 * tau : 0; });
+    std::vector<size_t> abundances(reads.size());
+    std::iota(abundances.begin(), abundances.end(), 1);
+
+    size_t num_full;
+    auto full = tauDistGraph(reads, kmer2reads, dist, tau, K, 1, num_full);
+
+    const size_t num_shards = 3;
+    std::vector<std::string> filenames;
+    size_t num_sharded = 0;
+    for (size_t i = num_shards; i-- > 0; ) {
+        auto queries = ReadRange::Shard(reads.size(), i, num_shards);
+        size_t num_shard;
+        auto shard = tauDistGraph(reads, kmer2reads, dist, tau, K, 1, num_shard, queries);
+        num_sharded += num_shard;
+        filenames.push_back("test_ig_matcher_shard" + std::to_string(i));
+        write_graph_shard(filenames.back(), shard, queries.begin, queries.end, reads.size(), true, &abundances);
+    }
+
+    bool undirected = false;
+    std::vector<size_t> weights;
+    auto merged = merge_graph_shards(filenames, undirected, weights);
+    for (const auto &filename : filenames) {
+        std::remove(filename.c_str());
+    }
+
+    EXPECT_TRUE(undirected);
+    EXPECT_EQ(weights, abundances);
+    EXPECT_EQ(num_sharded, num_full);
+    EXPECT_EQ(merged, full);
+}
+
+TEST(graph_shards, reference_shards_match_full_graph) {
+    // Reference reads outnumber queries, so targets of edges exceed the number of vertices
+    std::mt19937 rnd(53);
+    auto reference = random_reads(20, 40, 90, 59);
+    std::vector<Dna5String> queries;
+    for (size_t i = 0; i < 4; ++i) {
+        queries.push_back(mutate(reference[5 * i + 4], rnd() % 3, rnd));
+    }
+    const unsigned tau = 3, K = 5;
+    auto kmer2reads = kmerIndexConstruction(reference, K);
+    auto dist = half_sw_distance(2, [](int l) -> size_t { return l ? 2 * tau : 0; });
+
+    size_t num_full;
+    auto full = tauMatchGraph(queries, reference, kmer2reads, dist, tau, K, 1, num_full);
+    ASSERT_GT(full.Edges().size(), 0u);
+
+    const size_t num_shards = 2;
+    std::vector<std::string> filenames;
+    for (size_t i = 0; i < num_shards; ++i) {
+        auto range = ReadRange::Shard(queries.size(), i, num_shards);
+        size_t num_shard;
+        auto shard = tauMatchGraph(queries, reference, kmer2reads, dist, tau, K, 1, num_shard, range);
+        filenames.push_back("test_ig_matcher_reference_shard" + std::to_string(i));
+        write_graph_shard(filenames.back(), shard, range.begin, range.end, reference.size(), false);
+    }
+
+    bool undirected = true;
+    std::vector<size_t> weights;
+    auto merged = merge_graph_shards(filenames, undirected, weights);
+    for (const auto &filename : filenames) {
+        std::remove(filename.c_str());
+    }
+
+    EXPECT_FALSE(undirected);
+    EXPECT_TRUE(weights.empty());
+    EXPECT_EQ(merged, full);
+}
+
+TEST(kmer_index, merge_and_save_load) {
+    auto reads = random_reads(300, 30, 80, 47);
+    const size_t K = 7;
+    std::vector<Dna5String> base_reads(reads.begin(), reads.begin() + 200);
+    std::vector<Dna5String> new_reads(reads.begin() + 200, reads.end());
+
+    KmerIndex full(reads, K);
+    auto merged = KmerIndex::merge(KmerIndex(base_reads, K), KmerIndex(new_reads, K));
+    merged.save("test_ig_matcher_index");
+    auto loaded = KmerIndex::load("test_ig_matcher_index");
+    std::remove("test_ig_matcher_index");
+
+    for (const auto *index : { &merged, &loaded }) {
+        EXPECT_EQ(index->K(), K);
+        EXPECT_EQ(index->num_reads(), reads.size());
+        EXPECT_EQ(index->size(), full.size());
+        EXPECT_EQ(index->num_postings(), full.num_postings());
+        for (const auto &read : reads) {
+            for (const auto &kmer : algorithms::kmer_hashes(read, K)) {
+                auto expected = full.find(kmer.hash);
+                auto actual = index->find(kmer.hash);
+                ASSERT_EQ(actual.size(), expected.size());
+                ASSERT_TRUE(std::equal(expected.begin(), expected.end(), actual.begin()));
+            }
+        }
+    }
+}
+
+TEST(tau_increment_graph, matches_full_graph) {
+    // Short clones and their copies extended by long tails, so that new reads are much longer or much shorter
+    // than their base neighbours, and some reads are too short for candidate search with larger strategies
+    auto reads = clustered_reads(40, 20, 60, 4, 2, 116);
+    auto tails = random_reads(reads.size() / 2, 150, 250, 812);
+    for (size_t i = 0; i < tails.size(); ++i) {
+        Dna5String extended = reads[2 * i];
+        seqan::append(extended, tails[i]);
+        reads.push_back(extended);
+    }
+    std::mt19937 rnd(116);
+    std::shuffle(reads.begin(), reads.end(), rnd);
+    std::vector<Dna5String> base_reads(reads.begin(), reads.begin() + reads.size() / 2);
+    std::vector<Dna5String> new_reads(reads.begin() + reads.size() / 2, reads.end());
+
+    const unsigned tau = 3, K = 5;
+    auto kmer2reads = kmerIndexConstruction(reads, K);
+    auto base_kmer2reads = kmerIndexConstruction(base_reads, K);
+    auto new_kmer2reads = kmerIndexConstruction(new_reads, K);
+    for (unsigned strategy : { 1, 2, 3 }) {
+        for (int max_indels : { 0, 2 }) {
+            auto dist = half_sw_distance(max_indels, [](int) -> size_t { return 0; });
+
+            size_t num_full, num_base, num_increment;
+            auto full = tauDistGraph(reads, kmer2reads, dist, tau, K, strategy, num_full);
+            auto base = tauDistGraph(base_reads, base_kmer2reads, dist, tau, K, strategy, num_base);
+            auto increment = tauIncrementGraph(base_reads, new_reads, base_kmer2reads, new_kmer2reads,
+                                               dist, tau, K, strategy, num_increment);
+
+            auto updated = add_edges(*to_sparse_graph(base, std::vector<size_t>(base.size(), 1)), increment);
+            EXPECT_EQ(updated, full) << "strategy " << strategy << ", max_indels " << max_indels;
+            EXPECT_GT(numEdges(increment), 0u);
+        }
+    }
+}
+
+TEST(tau_increment_graph, longer_new_read) {
+    // All anchors of the new read are beyond the end of the base read
+    auto base_reads = random_reads(1, 40, 40, 67);
+    Dna5String extended = base_reads[0];
+    seqan::append(extended, random_reads(1, 200, 200, 71)[0]);
+    std::vector<Dna5String> new_reads = { extended };
+    std::vector<Dna5String> reads = { base_reads[0], extended };
+
+    const unsigned tau = 2, K = 5;
+    auto dist = half_sw_distance(0, [](int) -> size_t { return 0; });
+    size_t num_full, num_increment;
+    auto full = tauDistGraph(reads, kmerIndexConstruction(reads, K), dist, tau, K, 1, num_full);
+    auto increment = tauIncrementGraph(base_reads, new_reads,
+                                       kmerIndexConstruction(base_reads, K), kmerIndexConstruction(new_reads, K),
+                                       dist, tau, K, 1, num_increment);
+
+    EXPECT_EQ(numEdges(full), 1u);
+    EXPECT_EQ(increment, full);
+}
+
+TEST(reference_index, save_load) {
+    auto reads = random_reads(300, 0, 100, 53);
+    const size_t K = 7;
+
+    ReferenceIndex built(PackedReadStore(reads), K, 3, 12345);
+    built.save("test_ig_matcher_reference_index");
+    auto loaded = ReferenceIndex::load("test_ig_matcher_reference_index");
+    std::remove("test_ig_matcher_reference_index");
+
+    EXPECT_EQ(loaded.K(), K);
+    EXPECT_EQ(loaded.strategy(), 3u);
+    EXPECT_EQ(loaded.source_checksum(), 12345u);
+    EXPECT_EQ(loaded.kmer_index().num_reads(), reads.size());
+    EXPECT_EQ(loaded.kmer_index().size(), built.kmer_index().size());
+    EXPECT_EQ(loaded.kmer_index().num_postings(), built.kmer_index().num_postings());
+
+    ASSERT_EQ(loaded.reads().size(), reads.size());
+    for (size_t j = 0; j < reads.size(); ++j) {
+        ASSERT_EQ(length(loaded.reads()[j]), length(reads[j]));
+        for (size_t i = 0; i < length(reads[j]); ++i) {
+            ASSERT_EQ(seqan::ordValue(loaded.reads()[j][i]), seqan::ordValue(reads[j][i]));
+        }
+        for (const auto &kmer : algorithms::kmer_hashes(reads[j], K)) {
+            auto expected = built.kmer_index().find(kmer.hash);
+            auto actual = loaded.kmer_index().find(kmer.hash);
+            ASSERT_EQ(actual.size(), expected.size());
+            ASSERT_TRUE(std::equal(expected.begin(), expected.end(), actual.begin()));
+        }
+    }
+}
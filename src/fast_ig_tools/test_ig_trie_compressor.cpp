@@ -1,6 +1,10 @@
 #include <gmock/gmock.h>
 
+#include <random>
+#include <set>
+
 #include "ig_trie_compressor.hpp"
+#include "external_compressor.hpp"
 
 using fast_ig_tools::Compressor;
 using namespace ::testing;
@@ -48,3 +52,139 @@ TEST(basic_tests, hashmap_test) {
     EXPECT_THAT(indices, ElementsAre(0, 1, 0, 3, 4, 5, 4, 7, 1));
     EXPECT_THAT(comp_reads, ElementsAre("AAA", "AAAA", "", "XXX", "sdadasdasd", "X"));
 }
+
+TEST(partitioned_tests, matches_trie_compressor) {
+    std::mt19937 rnd(5);
+    const std::string alphabet = "ACGT";
+    std::vector<std::string> reads = {"", "A", "AC"};
+    for (size_t i = 0; i < 2000; ++i) {
+        // Short reads over a small alphabet are prefixes of many others
+        std::string s;
+        size_t len = rnd() % 8;
+        for (size_t j = 0; j < len; ++j) {
+            s += alphabet[rnd() % ((j < 3) ? 2 : 4)];
+        }
+        reads.push_back(s);
+    }
+    std::shuffle(reads.begin(), reads.end(), rnd);
+
+    for (bool with_empty : { false, true }) {
+        // The empty read joins everything
+        std::vector<seqan::Dna5String> input;
+        for (const auto &read : reads) {
+            if (!read.empty() || with_empty) {
+                input.push_back(seqan::Dna5String(read));
+            }
+        }
+
+        auto expected = Compressor::compressed_reads_indices(input, Compressor::Type::TrieCompressor);
+        EXPECT_EQ(Compressor::compressed_reads_indices(input, Compressor::Type::PartitionedTrieCompressor), expected);
+        for (size_t prefix_length : { 1, 2, 3, 5, 10 }) {
+            fast_ig_tools::PartitionedTrieCompressor<seqan::Dna5> compressor(input, prefix_length);
+            EXPECT_EQ(compressor.checkout(), expected) << "prefix length " << prefix_length;
+        }
+    }
+}
+
+TEST(partitioned_tests, basic_tests) {
+    std::vector<std::string> reads = {"AAAA", "AAA", "AAAC", "XX", "XXAA", "X", "sdadasdasd"};
+
+    auto indices = Compressor::compressed_reads_indices(reads, Compressor::Type::PartitionedTrieCompressor);
+    EXPECT_THAT(indices, ElementsAre(1, 1, 1, 5, 5, 5, 6));
+    EXPECT_THAT(indices, Compressor::compressed_reads_indices(reads, Compressor::Type::TrieCompressor));
+}
+
+TEST(radix_tests, matches_trie_compressor) {
+    std::mt19937 rnd(7);
+    const std::string alphabet = "ACGTN";
+    std::vector<std::string> bases;
+    for (size_t i = 0; i < 20; ++i) {
+        std::string s;
+        for (size_t j = 0; j < 70; ++j) {
+            s += alphabet[rnd() % ((j < 2) ? 2 : 5)];
+        }
+        bases.push_back(s);
+    }
+
+    // Prefixes of common sequences of lengths around word boundaries and the same with a mutation
+    std::vector<std::string> reads;
+    for (size_t i = 0; i < 3000; ++i) {
+        std::string s = bases[rnd() % bases.size()].substr(0, 1 + rnd() % 70);
+        if (rnd() % 3 == 0) {
+            s[rnd() % s.size()] = alphabet[rnd() % 5];
+        }
+        reads.push_back(s);
+    }
+
+    std::vector<seqan::Dna5String> dna_reads(reads.cbegin(), reads.cend());
+    auto expected = Compressor::compressed_reads_indices(dna_reads, Compressor::Type::TrieCompressor);
+    EXPECT_EQ(Compressor::compressed_reads_indices(dna_reads, Compressor::Type::RadixTrieCompressor), expected);
+    EXPECT_EQ(Compressor::compressed_reads_indices(reads, Compressor::Type::RadixTrieCompressor),
+              Compressor::compressed_reads_indices(reads, Compressor::Type::TrieCompressor));
+    EXPECT_LT(std::set<size_t>(expected.cbegin(), expected.cend()).size(), reads.size() / 2);
+}
+
+TEST(radix_tests, basic_tests) {
+    std::vector<std::string> reads = {"AAAA", "AAA", "AAAC", "XX", "XXAA", "X", "sdadasdasd", "AAA"};
+
+    auto indices = Compressor::compressed_reads_indices(reads, Compressor::Type::RadixTrieCompressor);
+    EXPECT_THAT(indices, ElementsAre(1, 1, 1, 5, 5, 5, 6, 1));
+
+    reads.push_back("");
+    indices = Compressor::compressed_reads_indices(reads, Compressor::Type::RadixTrieCompressor);
+    EXPECT_THAT(indices, ElementsAre(8, 8, 8, 8, 8, 8, 8, 8, 8));
+}
+
+TEST(external_tests, matches_trie_compressor) {
+    std::mt19937 rnd(11);
+    const std::string alphabet = "ACGTN";
+    std::string base;
+    for (size_t j = 0; j < 100; ++j) {
+        base += alphabet[rnd() % 4];
+    }
+
+    std::vector<seqan::Dna5String> reads;
+    {
+        seqan::SeqFileOut output("test_external_compressor.fa");
+        for (size_t i = 0; i < 2000; ++i) {
+            std::string s = base.substr(rnd() % 3, 1 + rnd() % 90);
+            if (rnd() % 2 == 0) {
+                s[rnd() % s.size()] = alphabet[rnd() % 5];
+            }
+            reads.push_back(s);
+            seqan::writeRecord(output, std::to_string(i), reads.back());
+        }
+    }
+
+    // Small chunks and fan-in make several merge passes
+    using fast_ig_tools::external_compressed_reads_indices;
+    EXPECT_EQ(external_compressed_reads_indices("test_external_compressor.fa", true, 4096, "test_external_compressor", 3),
+              Compressor::compressed_reads_indices(reads, Compressor::Type::TrieCompressor));
+    EXPECT_EQ(external_compressed_reads_indices("test_external_compressor.fa", false, 4096, "test_external_compressor", 3),
+              Compressor::compressed_reads_indices(reads, Compressor::Type::HashCompressor));
+    EXPECT_EQ(external_compressed_reads_indices("test_external_compressor.fa", true, 1 << 20, "test_external_compressor"),
+              Compressor::compressed_reads_indices(reads, Compressor::Type::TrieCompressor));
+    std::remove("test_external_compressor.fa");
+}
+
+TEST(fingerprint_tests, matches_hash_compressor) {
+    std::mt19937 rnd(13);
+    const std::string alphabet = "ACGTN";
+    std::vector<std::string> reads;
+    for (size_t i = 0; i < 5000; ++i) {
+        std::string s;
+        for (size_t j = 0, len = rnd() % 50; j < len; ++j) {
+            s += alphabet[rnd() % ((j < 45) ? 1 : 5)];
+        }
+        reads.push_back(s);
+    }
+
+    std::vector<seqan::Dna5String> dna_reads(reads.cbegin(), reads.cend());
+    auto expected = Compressor::compressed_reads_indices(reads, Compressor::Type::HashCompressor);
+    EXPECT_EQ(Compressor::compressed_reads_indices(dna_reads, Compressor::Type::FingerprintHashCompressor), expected);
+    EXPECT_EQ(Compressor::compressed_reads_indices(reads, Compressor::Type::FingerprintHashCompressor), expected);
+
+    reads = {"AAA", "AAAA", "AAA", "", "sdadasdasd", "", "AAAA"};
+    EXPECT_THAT(Compressor::compressed_reads_indices(reads, Compressor::Type::FingerprintHashCompressor),
+                ElementsAre(0, 1, 0, 3, 4, 3, 1));
+}
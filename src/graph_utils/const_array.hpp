@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+/*
+    class ConstArray is a read-only array that either owns its elements
+    or refers to external memory (e.g., a region of a memory-mapped file) kept alive by holder_
+ */
+template<typename T>
+class ConstArray {
+    std::vector<T> owned_;
+    std::shared_ptr<const void> holder_;
+    const T *data_;
+    size_t size_;
+
+    void Repoint() {
+        if (!holder_)
+            data_ = owned_.data();
+    }
+
+public:
+    typedef T value_type;
+    typedef const T* const_iterator;
+
+    ConstArray() : data_(nullptr), size_(0) { }
+
+    ConstArray(std::vector<T> elements) :
+            owned_(std::move(elements)), data_(owned_.data()), size_(owned_.size()) { }
+
+    ConstArray(const T *data, size_t size, std::shared_ptr<const void> holder) :
+            holder_(std::move(holder)), data_(data), size_(size) { }
+
+    ConstArray(const ConstArray &other) :
+            owned_(other.owned_), holder_(other.holder_), data_(other.data_), size_(other.size_) {
+        Repoint();
+    }
+
+    ConstArray(ConstArray &&other) :
+            owned_(std::move(other.owned_)), holder_(std::move(other.holder_)), data_(other.data_),
+            size_(other.size_) {
+        Repoint();
+        other.data_ = nullptr;
+        other.size_ = 0;
+    }
+
+    ConstArray& operator=(ConstArray other) {
+        owned_.swap(other.owned_);
+        holder_.swap(other.holder_);
+        size_ = other.size_;
+        data_ = other.data_;
+        Repoint();
+        return *this;
+    }
+
+    const T& operator[](size_t i) const { return data_[i]; }
+
+    size_t size() const { return size_; }
+
+    bool empty() const { return size_ == 0; }
+
+    const T* data() const { return data_; }
+
+    const_iterator begin() const { return data_; }
+
+    const_iterator end() const { return data_ + size_; }
+
+    // true if elements live in external memory
+    bool IsMapped() const { return bool(holder_); }
+};
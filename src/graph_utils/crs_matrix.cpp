@@ -1,56 +1,52 @@
 #include "crs_matrix.hpp"
 
-// valid only for consecutive filling of structure
-void CrsMatrix::AddEdge(size_t v1, size_t v2, size_t dist) {
-    assert(v1 < v2);
-    dist_.push_back(dist);
-    col_.push_back(v2);
-    row_index_[v1]++;
-}
-
-void CrsMatrix::ComputeRowIndex() {
+void CrsMatrix::Initialize(const vector<GraphEdge> &edges) {
+    NZ_ = edges.size();
+    vector<size_t> row_index(N_ + 1, 0);
+    vector<size_t> col;
+    vector<size_t> dist;
+    col.reserve(NZ_);
+    dist.reserve(NZ_);
+    // edges are consecutive, so filling is consecutive as well
+    for(auto it = edges.begin(); it != edges.end(); it++) {
+        assert(it->i < it->j);
+        dist.push_back(it->dist);
+        col.push_back(it->j);
+        row_index[it->i]++;
+    }
     size_t num_next_elem = 0;
     for(size_t i = 0; i < N_ + 1; i++) {
-        size_t tmp = row_index_[i];
-        row_index_[i] = num_next_elem;
+        size_t tmp = row_index[i];
+        row_index[i] = num_next_elem;
         num_next_elem += tmp;
     }
-}
-
-void CrsMatrix::Initialize(const vector<GraphEdge> &edges) {
-    ComputeN_NZ(edges);
-    InitializeRowIndex();
-    for(auto it = edges.begin(); it != edges.end(); it++)
-        AddEdge(it->i, it->j, it->dist);
-    ComputeRowIndex();
+    row_index_ = ConstArray<size_t>(std::move(row_index));
+    col_ = ConstArray<size_t>(std::move(col));
+    dist_ = ConstArray<size_t>(std::move(dist));
 }
 
 // NOTE: input matrix is transposed
 void CrsMatrix::Initialize(const CrsMatrix &trans_matrix) {
     N_ = trans_matrix.N();
     NZ_ = trans_matrix.NZ();
-    vector<vector<size_t> > trans_nz_col;
-    vector<vector<size_t> > trans_nz_val;
-    for(size_t i = 0; i < trans_matrix.N(); i++) {
-        trans_nz_col.push_back(vector<size_t>());
-        trans_nz_val.push_back(vector<size_t>());
-    }
-    for(size_t i = 0; i < trans_matrix.N(); i++)
+    // counting sort by column keeps rows of the transposed matrix sorted
+    vector<size_t> row_index(N_ + 1, 0);
+    for(size_t j = 0; j < NZ_; j++)
+        row_index[trans_matrix.Col()[j] + 1]++;
+    for(size_t i = 0; i < N_; i++)
+        row_index[i + 1] += row_index[i];
+    vector<size_t> col(NZ_);
+    vector<size_t> dist(NZ_);
+    vector<size_t> next(row_index.begin(), row_index.end() - 1);
+    for(size_t i = 0; i < N_; i++)
         for(size_t j = trans_matrix.RowIndex()[i]; j < trans_matrix.RowIndex()[i + 1]; j++) {
-            size_t row = i;
-            size_t col = trans_matrix.Col()[j];
-            size_t value = trans_matrix.Dist()[j];
-            trans_nz_col[col].push_back(row);
-            trans_nz_val[col].push_back(value);
+            size_t pos = next[trans_matrix.Col()[j]]++;
+            col[pos] = i;
+            dist[pos] = trans_matrix.Dist()[j];
         }
-    row_index_.push_back(0);
-    for(size_t i = 0; i < trans_nz_col.size(); i++) {
-        for(size_t j = 0; j < trans_nz_col[i].size(); j++) {
-            col_.push_back(trans_nz_col[i][j]);
-            dist_.push_back(trans_nz_val[i][j]);
-        }
-        row_index_.push_back(row_index_[row_index_.size() - 1] + trans_nz_col[i].size());
-    }
+    row_index_ = ConstArray<size_t>(std::move(row_index));
+    col_ = ConstArray<size_t>(std::move(col));
+    dist_ = ConstArray<size_t>(std::move(dist));
 }
 
 ostream& operator<<(ostream &out, const CrsMatrix &matrix) {
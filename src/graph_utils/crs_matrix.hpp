@@ -1,5 +1,6 @@
 #pragma once
 #include "include_me.hpp"
+#include "const_array.hpp"
 
 /*
     struct Edge characterizes edge of graph
@@ -26,29 +27,15 @@ class CrsMatrix {
     size_t NZ_;
 
     // rows and columns
-    vector<size_t> row_index_;
-    vector<size_t> col_;
+    ConstArray<size_t> row_index_;
+    ConstArray<size_t> col_;
 
     // weights
-    vector<size_t> dist_;
+    ConstArray<size_t> dist_;
 
     // isolated vertices
     vector<size_t> isolated_vertices_;
 
-    void InitializeRowIndex() {
-        for(size_t i = 0; i < N_+ 1; i++)
-            row_index_.push_back(0);
-    }
-
-    // valid only for consecutive filling of structure
-    void AddEdge(size_t v1, size_t v2, size_t dist);
-
-    void ComputeRowIndex();
-
-    void ComputeN_NZ(const vector<GraphEdge> &edges) {
-        NZ_ = edges.size();
-    }
-
     // edges are consecutive
     void Initialize(const vector<GraphEdge> &edges);
 
@@ -66,11 +53,22 @@ public:
         Initialize(edges);
     }
 
-    const vector<size_t>& Dist() const { return dist_; }
+    // takes ready arrays, e.g., the ones mapped from a binary graph file
+    CrsMatrix(size_t N, ConstArray<size_t> row_index, ConstArray<size_t> col, ConstArray<size_t> dist) :
+            N_(N),
+            NZ_(col.size()),
+            row_index_(std::move(row_index)),
+            col_(std::move(col)),
+            dist_(std::move(dist)) {
+        assert(row_index_.size() == N_ + 1);
+        assert(dist_.size() == NZ_);
+    }
+
+    const ConstArray<size_t>& Dist() const { return dist_; }
 
-    const vector<size_t>& RowIndex() const  { return row_index_; }
+    const ConstArray<size_t>& RowIndex() const  { return row_index_; }
 
-    const vector<size_t>& Col() const { return col_; }
+    const ConstArray<size_t>& Col() const { return col_; }
 
     size_t N() const { return N_; }
 
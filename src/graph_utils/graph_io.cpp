@@ -1,5 +1,7 @@
+#include <algorithm>
 #include <verify.hpp>
 #include "graph_io.hpp"
+#include "mapped_file.hpp"
 #include "../ig_tools/utils/string_tools.hpp"
 
 vector<string> SplitGraphString(string str) {
@@ -164,11 +166,12 @@ class VersatileGraphReader {
     }
 
 public:
-    SparseGraphPtr ReadGraph(std::ifstream &graph_stream) {
+    SparseGraphPtr ReadGraph(std::ifstream &graph_stream, bool &vertex_weighted) {
         string header_line;
         getline(graph_stream, header_line);
         vector<string> splits = SplitGraphString(header_line);
         size_t num_vertices = GetNumVertices(splits);
+        vertex_weighted = GraphIsEdgeVertexWeighted(splits);
         if (GraphIsUnweighted(splits)) {
             TRACE("Unweighted graph reader was chosen");
             return UnweightedGraphReader().ReadGraph(num_vertices, graph_stream);
@@ -189,6 +192,78 @@ private:
     DECL_LOGGER("VersatileGraphReader");
 };
 
+static_assert(sizeof(BinaryGraphHeader) == 48, "binary graph header must be 8-byte aligned");
+
+const char BinaryGraphHeader::kMagic[8] = { 'I', 'G', 'R', 'C', 'S', 'R', 'G', '\0' };
+
+namespace {
+    uint64_t BinaryGraphChecksum(const uint64_t *words, size_t num_words, uint64_t hash = 0xcbf29ce484222325ull) {
+        for (size_t i = 0; i < num_words; i++) {
+            hash ^= words[i];
+            hash *= 0x100000001b3ull;
+        }
+        return hash;
+    }
+
+    bool FileStartsWithBinaryMagic(const std::string &filename) {
+        std::ifstream in(filename, std::ios::binary);
+        char magic[sizeof(BinaryGraphHeader::kMagic)];
+        if (!in.read(magic, sizeof(magic)))
+            return false;
+        return std::equal(magic, magic + sizeof(magic), BinaryGraphHeader::kMagic);
+    }
+}
+
+GraphFormat GraphFormatFromString(const std::string &format) {
+    if (format == "auto")
+        return GraphFormat::Auto;
+    if (format == "metis")
+        return GraphFormat::Metis;
+    VERIFY_MSG(format == "binary", "Unknown graph format " << format << ", expected auto, metis or binary");
+    return GraphFormat::Binary;
+}
+
+SparseGraphPtr GraphReader::CreateGraphFromBinary() {
+    auto file = std::make_shared<MappedFile>(graph_filename);
+    if (!file->Good() || file->Size() < sizeof(BinaryGraphHeader)) {
+        WARN("File " + graph_filename + " does not contain graph in binary format");
+        return SparseGraphPtr(NULL);
+    }
+    const BinaryGraphHeader &header = *reinterpret_cast<const BinaryGraphHeader*>(file->Data());
+    VERIFY_MSG(std::equal(header.magic, header.magic + sizeof(header.magic), BinaryGraphHeader::kMagic),
+               "File " << graph_filename << " is not a binary graph");
+    VERIFY_MSG(header.version == BinaryGraphHeader::kVersion,
+               "Unsupported version " << header.version << " of binary graph " << graph_filename);
+    VERIFY_MSG(header.word_size == sizeof(size_t), "Binary graph " << graph_filename << " was written with "
+               << header.word_size << "-byte words");
+    size_t num_words = header.NumPayloadWords();
+    VERIFY_MSG(file->Size() == sizeof(BinaryGraphHeader) + num_words * sizeof(uint64_t),
+               "Binary graph " << graph_filename << " is truncated");
+    const uint64_t *words = reinterpret_cast<const uint64_t*>(file->Data() + sizeof(BinaryGraphHeader));
+    VERIFY_MSG(BinaryGraphChecksum(words, num_words) == header.checksum,
+               "Checksum mismatch in binary graph " << graph_filename);
+
+    size_t N = header.N;
+    size_t NZ = header.NZ;
+    const size_t *p = reinterpret_cast<const size_t*>(words);
+    auto take = [&p, &file](size_t size) {
+        ConstArray<size_t> array(p, size, file);
+        p += size;
+        return array;
+    };
+    ConstArray<size_t> row_index = take(N + 1);
+    ConstArray<size_t> col = take(NZ);
+    ConstArray<size_t> dist = take(NZ);
+    CrsMatrixPtr direct_matrix(new CrsMatrix(N, std::move(row_index), std::move(col), std::move(dist)));
+    ConstArray<size_t> row_index_t = take(N + 1);
+    ConstArray<size_t> col_t = take(NZ);
+    ConstArray<size_t> dist_t = take(NZ);
+    CrsMatrixPtr trans_matrix(new CrsMatrix(N, std::move(row_index_t), std::move(col_t), std::move(dist_t)));
+    ConstArray<size_t> weight = take(N);
+    vertex_weighted = !(header.flags & BinaryGraphHeader::kWithoutWeights);
+    return SparseGraphPtr(new SparseGraph(direct_matrix, trans_matrix, std::move(weight)));
+}
+
 /*
  *
  */
@@ -199,7 +274,48 @@ SparseGraphPtr GraphReader::CreateGraph() {
         WARN("File " + this->graph_filename + " with graph was not found");
         return SparseGraphPtr(NULL);
     }
-    SparseGraphPtr graph_ptr = VersatileGraphReader().ReadGraph(graph_stream);
+    SparseGraphPtr graph_ptr;
+    if (format == GraphFormat::Binary ||
+            (format == GraphFormat::Auto && FileStartsWithBinaryMagic(graph_filename))) {
+        TRACE("Binary graph reader was chosen");
+        graph_ptr = CreateGraphFromBinary();
+        if (!graph_ptr)
+            return graph_ptr;
+    } else {
+        graph_ptr = VersatileGraphReader().ReadGraph(graph_stream, vertex_weighted);
+    }
     TRACE("Extracted graph contains " << graph_ptr->N() << " vertices & " << graph_ptr->NZ() << " edges");
     return graph_ptr;
-}
\ No newline at end of file
+}
+
+void GraphWriter::PrintBinaryGraph(SparseGraphPtr graph_ptr, bool vertex_weighted) {
+    static_assert(sizeof(size_t) == sizeof(uint64_t), "binary graph format requires 64-bit size_t");
+    const SparseGraph &graph = *graph_ptr;
+    vector<const ConstArray<size_t>*> sections = { &graph.RowIndex(), &graph.Col(), &graph.Dist(),
+                                                   &graph.RowIndexT(), &graph.ColT(), &graph.DistT(),
+                                                   &graph.Weight() };
+
+    BinaryGraphHeader header;
+    std::copy(BinaryGraphHeader::kMagic, BinaryGraphHeader::kMagic + sizeof(header.magic), header.magic);
+    header.version = BinaryGraphHeader::kVersion;
+    header.word_size = sizeof(size_t);
+    header.N = graph.N();
+    header.NZ = graph.NZ();
+    header.flags = vertex_weighted ? 0 : BinaryGraphHeader::kWithoutWeights;
+    header.checksum = 0xcbf29ce484222325ull;
+    size_t num_words = 0;
+    for (const auto section : sections) {
+        header.checksum = BinaryGraphChecksum(section->data(), section->size(), header.checksum);
+        num_words += section->size();
+    }
+    VERIFY(num_words == header.NumPayloadWords());
+
+    std::ofstream out(graph_filename, std::ios::binary);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    for (const auto section : sections) {
+        out.write(reinterpret_cast<const char*>(section->data()),
+                  static_cast<std::streamsize>(section->size() * sizeof(size_t)));
+    }
+    VERIFY_MSG(out.good(), "Failed to write graph to " << graph_filename);
+    TRACE("Graph with " << graph.N() << " vertices & " << graph.NZ() << " edges was written to " << graph_filename);
+}
@@ -1,17 +1,58 @@
 #pragma once
 
+#include <cstdint>
 #include "sparse_graph.hpp"
 
+/*
+    Binary graph format (native byte order, all fields are 8-byte aligned):
+        BinaryGraphHeader
+        direct row index (N + 1 x uint64), direct columns (NZ x uint64), direct distances (NZ x uint64)
+        transposed row index (N + 1 x uint64), transposed columns (NZ x uint64), transposed distances (NZ x uint64)
+        vertex weights (N x uint64)
+    Direct matrix is the upper triangle of the adjacency matrix exactly as it is stored in SparseGraph,
+    so the file is mapped into memory and used without any parsing or copying.
+    checksum is FNV-1a over 64-bit words of everything that follows the header.
+    Vertex weights are all 1 if kWithoutWeights is set in flags, i.e., the graph has no weights of its own
+ */
+struct BinaryGraphHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t word_size;
+    uint64_t N;
+    uint64_t NZ;
+    uint64_t checksum;
+    uint64_t flags;
+
+    static const char kMagic[8];
+    static const uint32_t kVersion = 1;
+    static const uint64_t kWithoutWeights = 1;
+
+    size_t NumPayloadWords() const { return 2 * (N + 1 + 2 * NZ) + N; }
+};
+
+enum class GraphFormat { Auto, Metis, Binary };
+
+// "auto", "metis" or "binary"
+GraphFormat GraphFormatFromString(const std::string &format);
+
 class GraphReader {
     std::string graph_filename;
+    GraphFormat format;
+    bool vertex_weighted = false;
+
+    SparseGraphPtr CreateGraphFromBinary();
 
 public:
-    GraphReader(std::string graph_filename) {
+    GraphReader(std::string graph_filename, GraphFormat format = GraphFormat::Auto) {
         this->graph_filename = graph_filename;
+        this->format = format;
     }
 
     SparseGraphPtr CreateGraph();
 
+    // Whether the graph read by CreateGraph has vertex weights, otherwise they are all 1
+    bool VertexWeighted() const { return vertex_weighted; }
+
 private:
     DECL_LOGGER("GraphReader");
 };
@@ -26,6 +67,9 @@ public:
 
     void PrintGraph(SparseGraphPtr graph_ptr);
 
+    // Weights of vertices are marked as absent unless vertex_weighted
+    void PrintBinaryGraph(SparseGraphPtr graph_ptr, bool vertex_weighted = true);
+
 private:
     DECL_LOGGER("GraphWriter");
-};
\ No newline at end of file
+};
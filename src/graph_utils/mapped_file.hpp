@@ -0,0 +1,41 @@
+#pragma once
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <string>
+
+// read-only mapping of the whole file, unmapped when the last array referring to it is destroyed
+class MappedFile {
+    void *data_;
+    size_t size_;
+
+public:
+    MappedFile(const std::string &filename) : data_(MAP_FAILED), size_(0) {
+        int fd = open(filename.c_str(), O_RDONLY);
+        if (fd < 0)
+            return;
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_size > 0) {
+            size_ = static_cast<size_t>(st.st_size);
+            data_ = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        }
+        close(fd);
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile() {
+        if (data_ != MAP_FAILED)
+            munmap(data_, size_);
+    }
+
+    bool Good() const { return data_ != MAP_FAILED; }
+
+    const char* Data() const { return static_cast<const char*>(data_); }
+
+    size_t Size() const { return size_; }
+};
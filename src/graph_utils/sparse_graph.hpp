@@ -15,7 +15,7 @@ private:
     CrsMatrixPtr direct_matrix_;
     CrsMatrixPtr trans_matrix_;
     // weights of vertices
-    vector<size_t> weight_;
+    ConstArray<size_t> weight_;
     vector<Vertex> vertex_;
     GraphComponentMap component_map_;
 
@@ -31,6 +31,17 @@ public:
 
     SparseGraph(size_t N, const vector<GraphEdge> &edges) : SparseGraph(N, edges, vector<size_t>(N, 1)) {}
 
+    // direct_matrix contains upper triangle, trans_matrix is its transposition (lower triangle)
+    SparseGraph(CrsMatrixPtr direct_matrix, CrsMatrixPtr trans_matrix, ConstArray<size_t> weight) :
+            direct_matrix_(direct_matrix), trans_matrix_(trans_matrix), weight_(std::move(weight)) {
+        assert(direct_matrix_->N() == trans_matrix_->N() && direct_matrix_->NZ() == trans_matrix_->NZ());
+        assert(weight_.size() == direct_matrix_->N());
+        vertex_.reserve(N());
+        for (size_t i = 0; i < N(); i++) {
+            vertex_.push_back(Vertex(*this, i));
+        }
+    }
+
     size_t N() const { return direct_matrix_->N(); }
 
     size_t NZ() const { return direct_matrix_->NZ(); }
@@ -45,19 +56,19 @@ public:
 
     const SparseGraph::Vertex VertexEdges(size_t idx) const { return SparseGraph::Vertex(*this, idx); }
 
-    const vector<size_t>& RowIndex() const { return direct_matrix_->RowIndex(); }
+    const ConstArray<size_t>& RowIndex() const { return direct_matrix_->RowIndex(); }
 
-    const vector<size_t>& RowIndexT() const { return trans_matrix_->RowIndex(); }
+    const ConstArray<size_t>& RowIndexT() const { return trans_matrix_->RowIndex(); }
 
-    const vector<size_t>& Col() const { return direct_matrix_->Col(); }
+    const ConstArray<size_t>& Col() const { return direct_matrix_->Col(); }
 
-    const vector<size_t>& ColT() const { return trans_matrix_->Col(); }
+    const ConstArray<size_t>& ColT() const { return trans_matrix_->Col(); }
 
-    const vector<size_t>& Dist() const { return direct_matrix_->Dist(); }
+    const ConstArray<size_t>& Dist() const { return direct_matrix_->Dist(); }
 
-    const vector<size_t>& DistT() const { return trans_matrix_->Dist(); }
+    const ConstArray<size_t>& DistT() const { return trans_matrix_->Dist(); }
 
-    const vector<size_t>& Weight() const { return weight_; }
+    const ConstArray<size_t>& Weight() const { return weight_; }
 
     size_t WeightOfVertex(size_t vertex_index) const;
 
@@ -1,6 +1,7 @@
 #include <gtest/gtest.h>
 #include <logger/log_writers.hpp>
 #include "../graph_utils/sparse_graph.hpp"
+#include "../graph_utils/graph_io.hpp"
 
 struct GraphPair {
     vector<vector<bool> > matrix_;
@@ -91,6 +92,43 @@ TEST_F(SparseGraphTestFixture, TestIterateEdges) {
     }
 }
 
+TEST_F(SparseGraphTestFixture, TestBinaryRoundTrip) {
+    const std::string filename = "test_sparse_graph.bin";
+    for (auto graph : graphs) {
+        GraphWriter(filename).PrintBinaryGraph(graph.sparse_);
+        for (auto format : { GraphFormat::Auto, GraphFormat::Binary }) {
+            GraphReader reader(filename, format);
+            SparseGraphPtr loaded = reader.CreateGraph();
+            ASSERT_TRUE(bool(loaded));
+            ASSERT_TRUE(reader.VertexWeighted());
+            ASSERT_TRUE(loaded->RowIndex().IsMapped());
+            ASSERT_EQ(graph.sparse_->N(), loaded->N());
+            ASSERT_EQ(graph.sparse_->NZ(), loaded->NZ());
+            auto equal = [](const ConstArray<size_t> &a, const ConstArray<size_t> &b) {
+                return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin());
+            };
+            ASSERT_TRUE(equal(graph.sparse_->RowIndex(), loaded->RowIndex()));
+            ASSERT_TRUE(equal(graph.sparse_->Col(), loaded->Col()));
+            ASSERT_TRUE(equal(graph.sparse_->Dist(), loaded->Dist()));
+            ASSERT_TRUE(equal(graph.sparse_->RowIndexT(), loaded->RowIndexT()));
+            ASSERT_TRUE(equal(graph.sparse_->ColT(), loaded->ColT()));
+            ASSERT_TRUE(equal(graph.sparse_->DistT(), loaded->DistT()));
+            ASSERT_TRUE(equal(graph.sparse_->Weight(), loaded->Weight()));
+            for (size_t i = 0; i < graph.matrix_.size(); i ++) {
+                for (size_t j = 0; j < graph.matrix_.size(); j ++) {
+                    ASSERT_EQ(graph.matrix_[i][j], loaded->HasEdge(i, j));
+                }
+            }
+        }
+
+        GraphWriter(filename).PrintBinaryGraph(graph.sparse_, false);
+        GraphReader reader(filename);
+        ASSERT_TRUE(bool(reader.CreateGraph()));
+        ASSERT_FALSE(reader.VertexWeighted());
+    }
+    std::remove(filename.c_str());
+}
+
 void create_console_logger() {
     using namespace logging;
 
@@ -20,79 +20,15 @@ namespace clusterer {
         };
     }
 
-    ReadDist ClusteringMode::bounded_edit_dist(size_t limit, size_t max_indels, bool binary) {
-        return [limit, max_indels, binary](const seqan::Dna5String& first, const seqan::Dna5String& second) {
-            const size_t INF = std::numeric_limits<size_t>::max() / 2;
-
-            const size_t indel_cost = 1;
-            const size_t mismatch_cost = 1;
-
-            const size_t first_len = length(first);
-            const size_t second_len = length(second);
-
-            if (abs_diff(first_len, second_len) > std::min(limit, max_indels)) {
+    ReadDist ClusteringMode::bounded_edit_dist(size_t limit, size_t max_indels) {
+        return [limit, max_indels](const seqan::Dna5String& first, const seqan::Dna5String& second) {
+            if (abs_diff(length(first), length(second)) > std::min(limit, max_indels)) {
                 return limit + 1;
             }
 
-            std::vector<size_t> dp1(2 * max_indels + 1, INF);
-            std::vector<size_t> dp2(2 * max_indels + 1);
-            for (size_t j = 0; j <= max_indels && j <= second_len; j ++) {
-                dp1[max_indels + j] = j;
-            }
-
-            for (size_t i = 0; i < first_len; i ++) {
-                std::vector<size_t>& dp_cur = (i & 1) ? dp1 : dp2;
-                std::vector<size_t>& dp_prev = (i & 1) ? dp2 : dp1;
-                std::fill(dp_cur.begin(), dp_cur.end(), INF);
-
-                for (size_t index = 0; index <= 2 * max_indels; index ++) {
-                    if ( i + index < max_indels) continue;
-                    if (i + index <= second_len + max_indels) {
-                        if (index > 0) {
-                            // i + 1 + index - 1 - max_indels
-                            dp_cur[index - 1] = std::min(dp_cur[index - 1], dp_prev[index] + indel_cost);
-
-                            // i + 1 + index (- 1) - max_indels
-                            if (i + 1 + index <= second_len + max_indels) {
-                                dp_cur[index] = std::min(dp_cur[index], dp_cur[index - 1] + indel_cost);
-                            }
-                        }
-
-                        // i (+ 1) + index - max_indels
-                        if (i + 1 + index <= second_len + max_indels) {
-                            dp_cur[index] = std::min(dp_cur[index], dp_prev[index] + (first[i] == second[index - max_indels + i] ? 0 : mismatch_cost));
-                        }
-                    }
-                }
-//                INFO( i );
-//                for (size_t index = 0; index <= 2 * max_indels; index ++) {
-//                    std::cout << dp_cur[index] << " ";
-//                }
-//                std::cout << std::endl;
-
-                bool all_too_large = true;
-                for (size_t index = 0; index <= 2 * max_indels; index ++) {
-                    size_t first_left = first_len - i - 1;
-                    if (i + 1 + index > second_len + max_indels) break;
-                    size_t second_left = second_len - i - 1 - index + max_indels;
-                    size_t diff = abs_diff(first_left, second_left);
-                    size_t lower = dp_cur[index] + diff;
-                    if (lower <= limit) {
-                        all_too_large = false;
-                    }
-                    size_t upper = dp_cur[index] + first_left + second_left;
-                    if (binary && upper <= limit) {
-//                        INFO("Pessimistic is " << upper << " for index " << index);
-                        return upper;
-                    }
-                }
-                if (all_too_large) {
-//                    INFO("Optimistic is too high");
-                    return limit + 1;
-                }
-            }
-            std::vector<size_t>& dp = (first_len & 1) ? dp2 : dp1;
-            return std::min(dp[max_indels + second_len - first_len], limit + 1);
+            // Global alignment: once one of the sequences is exhausted, the rest of the other one is deleted
+            auto tail_cost = [](int l) -> size_t { return static_cast<size_t>(l); };
+            return half_edit_dist_banded(first, second, tail_cost, max_indels, limit);
         };
     }
 
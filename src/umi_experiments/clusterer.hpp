@@ -10,6 +10,7 @@
 #include "utils/io.hpp"
 #include "../fast_ig_tools/ig_final_alignment.hpp"
 #include "../fast_ig_tools/ig_matcher.hpp"
+#include "../fast_ig_tools/banded_half_smith_waterman.hpp"
 
 namespace clusterer {
 
@@ -65,9 +66,8 @@ namespace clusterer {
 
         // return function returning hamming distance if it's <= limit or limit + 1 otherwise
         static ReadDist bounded_hamming_dist(size_t limit);
-        // if binary is true, return function returning edit distance if it's <= limit and limit + 1 otherwise
-        // else return function returning some number <= limit if edit distance <= limit and + 1 limit otherwise
-        static ReadDist bounded_edit_dist(size_t limit, size_t max_indels, bool binary = true);
+        // return function returning edit distance if it's <= limit and limit + 1 otherwise
+        static ReadDist bounded_edit_dist(size_t limit, size_t max_indels);
         static ClusterDistChecker clusters_close_by_center(const ReadDist& read_dist, size_t limit);
         static ClusterDistChecker clusters_close_by_min(const ReadDist& read_dist, size_t limit);
     };
@@ -385,15 +385,15 @@ namespace clusterer {
         const size_t max_indels = 3;
         const size_t strategy = 2;
         const size_t k = IG_LEN / (tau + strategy) / 2;
-        Graph left_graph;
-        Graph right_graph;
+        CsrGraph left_graph;
+        CsrGraph right_graph;
         omp_set_num_threads(static_cast<int>(num_threads));
         for (size_t i = 0; i < 2; i ++) {
             INFO("constructing graph " << i);
             const std::vector<seqan::Dna5String>& all_halves = (i == 0) ? all_left_halves : all_right_halves;
             auto kmer2reads = kmerIndexConstruction(all_halves, k);
             size_t num_of_dist_computations = 0;
-            Graph& graph = (i == 0) ? left_graph : right_graph;
+            CsrGraph& graph = (i == 0) ? left_graph : right_graph;
             graph = tauDistGraph(all_halves, kmer2reads, ClusteringMode::bounded_edit_dist(tau, max_indels),
                                  static_cast<unsigned>(tau), static_cast<unsigned>(k), static_cast<unsigned>(strategy),
                                  num_of_dist_computations);
@@ -402,11 +402,6 @@ namespace clusterer {
             INFO("graph written: " << i);
         }
 
-        for (size_t i = 0; i < left_graph.size(); i ++) {
-            std::sort(left_graph[i].begin(), left_graph[i].end());
-            std::sort(right_graph[i].begin(), right_graph[i].end());
-        }
-
         size_t total_minor_clusters = 0;
         size_t found_somewhere = 0;
         size_t found_within_umi = 0;
@@ -476,7 +471,7 @@ namespace clusterer {
                 if (left_in_all > 0 && right_in_all > 0) {
                     found_somewhere ++;
                 }
-                const auto sw_dist = ClusteringMode::bounded_edit_dist(40, 15, false);
+                const auto sw_dist = ClusteringMode::bounded_edit_dist(40, 15);
                 if (left_in_umi > 0 && right_in_umi > 0) {
                     found_within_umi ++;
                     umi_chimeras_file << "size: " << cluster->weight << " (max = " << max_size << ")" << std::endl;
@@ -3,6 +3,7 @@
 #include <umi_utils.hpp>
 #include <clusterer.hpp>
 #include <segfault_handler.hpp>
+#include "../../fast_ig_tools/column_profile.hpp"
 
 namespace {
     struct Params {
@@ -70,20 +71,16 @@ seqan::Dna5String calculate_consensus(const std::vector<seqan::Dna5String>& read
         }
     }
 
-    auto GetIndexNucl = [](const seqan::Dna5 &nucl) {
-        return static_cast<size_t>(seqan::ordValue(nucl));
-    };
-
+    // The most frequent nucleotide, the one of the shortest read or the first one of equally frequent ones
+    ColumnProfile<seqan::Dna5> profile(reads, idx_list);
     for (size_t pos = 0; pos < length(consensus); pos ++) {
-        std::vector<size_t> nt_counts(4);
-        for (size_t idx : idx_list) {
-            nt_counts[GetIndexNucl(reads[idx][pos])] ++;
-        }
+        size_t best = seqan::ordValue(consensus[pos]);
         for (size_t i = 0; i < 4; i ++) {
-            if (nt_counts[i] > nt_counts[GetIndexNucl(consensus[pos])]) {
-                consensus[pos] = i;
+            if (profile.count(pos, i) > profile.count(pos, best)) {
+                best = i;
             }
         }
+        consensus[pos] = best;
     }
     return consensus;
 }
@@ -51,7 +51,7 @@ int main(int, const char* const* argv) {
     auto id2read = get_id_to_read_map(reads_file);
     const auto clusters = get_clusters_from_rcm(rcm_file);
     
-    const auto get_dist = clusterer::ClusteringMode::bounded_edit_dist(max_dist, max_dist, false);
+    const auto get_dist = clusterer::ClusteringMode::bounded_edit_dist(max_dist, max_dist);
     std::ofstream ofs(dist_output_file);
     omp_set_num_threads(threads);
     SEQAN_OMP_PRAGMA(parallel for schedule(dynamic, 8))
@@ -8,7 +8,7 @@ void calc_and_write(int threads, const std::vector<seqan::Dna5String>& reads, si
 
     const size_t size = reads.size();
     std::vector<size_t> dists(max_dist + 2);
-    const auto& get_dist = clusterer::ClusteringMode::bounded_edit_dist(max_dist, max_dist, false);
+    const auto& get_dist = clusterer::ClusteringMode::bounded_edit_dist(max_dist, max_dist);
     SEQAN_OMP_PRAGMA(parallel for schedule(dynamic, 8))
     for (size_t i = 0; i < size; i ++) {
         std::vector<size_t> local_dists(max_dist + 2);
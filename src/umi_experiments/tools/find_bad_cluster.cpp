@@ -120,7 +120,7 @@ namespace {
 
 void find_cluster(Input& input) {
     const auto dist0 = clusterer::ClusteringMode::bounded_edit_dist(0, 1);
-    const auto dist = clusterer::ClusteringMode::bounded_edit_dist(2, 1, false);
+    const auto dist = clusterer::ClusteringMode::bounded_edit_dist(2, 1);
     size_t bad_count = 0;
     for (size_t i = 0; i < input.repertoire_ids.size(); i ++) {
         bool found = false;